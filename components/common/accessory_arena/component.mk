@@ -0,0 +1,15 @@
+# Component makefile for accessory_arena
+
+ifdef component_compile_rules
+    # ESP_OPEN_RTOS
+    INC_DIRS += $(accessory_arena_ROOT)/include
+
+    accessory_arena_SRC_DIR = $(accessory_arena_ROOT)/src
+
+    $(eval $(call component_compile_rules,accessory_arena))
+else
+    # ESP_IDF
+    COMPONENT_SRCDIRS = src
+    COMPONENT_ADD_INCLUDEDIRS = include
+    COMPONENT_DEPENDS = homekit
+endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <homekit/types.h>
+
+/* Bump allocator for accessory databases that are built once at boot and
+   never freed. The whole graph (accessories, services, characteristics,
+   their pointer arrays, callbacks and strings) is carved out of one
+   caller provided buffer instead of a malloc() per object.
+
+   If the buffer turns out too small, allocations fall back to the heap
+   and are counted in overflow, so a wrong size shows up in the report
+   instead of breaking the accessory. */
+
+typedef struct {
+    uint8_t *buffer;
+    size_t size;
+    size_t used;
+    size_t overflow;    // bytes that didn't fit and were malloc()ed
+} accessory_arena_t;
+
+// Space an object of given size takes in the arena, for sizing buffers at build time
+#define ACCESSORY_ARENA_SIZEOF(size) (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+void accessory_arena_init(accessory_arena_t *arena, void *buffer, size_t size);
+
+void *accessory_arena_alloc(accessory_arena_t *arena, size_t size);
+char *accessory_arena_printf(accessory_arena_t *arena, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Copy a (usually stack allocated) object into the arena. Limits, valid
+   values and change callbacks of characteristics are copied too, strings
+   (type, description, string values) are referenced as is, so they have
+   to be literals or come from accessory_arena_printf(). Services and
+   accessories copy their NULL terminated pointer arrays, not the objects
+   they point to. */
+homekit_characteristic_t *accessory_arena_characteristic(accessory_arena_t *arena, const homekit_characteristic_t *ch);
+homekit_service_t *accessory_arena_service(accessory_arena_t *arena, const homekit_service_t *service);
+homekit_accessory_t *accessory_arena_accessory(accessory_arena_t *arena, const homekit_accessory_t *accessory);
+
+void accessory_arena_report(accessory_arena_t *arena);
+
+// Arena counterparts of NEW_HOMEKIT_CHARACTERISTIC() and friends
+#define ARENA_HOMEKIT_CHARACTERISTIC(arena, name, ...) \
+    accessory_arena_characteristic(arena, HOMEKIT_CHARACTERISTIC(name, ##__VA_ARGS__))
+#define ARENA_HOMEKIT_SERVICE(arena, _type, ...) \
+    accessory_arena_service(arena, HOMEKIT_SERVICE(_type, ##__VA_ARGS__))
+#define ARENA_HOMEKIT_ACCESSORY(arena, ...) \
+    accessory_arena_accessory(arena, HOMEKIT_ACCESSORY(__VA_ARGS__))
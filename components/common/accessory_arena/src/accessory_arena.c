@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <accessory_arena.h>
+
+#define ARENA_ALIGN sizeof(void*)
+
+void accessory_arena_init(accessory_arena_t *arena, void *buffer, size_t size) {
+    arena->buffer = buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->overflow = 0;
+}
+
+void *accessory_arena_alloc(accessory_arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if (arena->used + size > arena->size) {
+        arena->overflow += size;
+        return calloc(1, size);
+    }
+
+    void *p = arena->buffer + arena->used;
+    arena->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+static void *accessory_arena_copy(accessory_arena_t *arena, const void *data, size_t size) {
+    if (!data)
+        return NULL;
+
+    void *p = accessory_arena_alloc(arena, size);
+    if (p)
+        memcpy(p, data, size);
+    return p;
+}
+
+static void *accessory_arena_copy_list(accessory_arena_t *arena, void * const *list) {
+    if (!list)
+        return NULL;
+
+    size_t count = 0;
+    while (list[count])
+        count++;
+
+    return accessory_arena_copy(arena, list, (count + 1) * sizeof(*list));
+}
+
+char *accessory_arena_printf(accessory_arena_t *arena, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    char *s = accessory_arena_alloc(arena, len + 1);
+    if (!s)
+        return NULL;
+
+    va_start(args, format);
+    vsnprintf(s, len + 1, format, args);
+    va_end(args);
+
+    return s;
+}
+
+homekit_characteristic_t *accessory_arena_characteristic(accessory_arena_t *arena, const homekit_characteristic_t *ch) {
+    homekit_characteristic_t *clone = accessory_arena_copy(arena, ch, sizeof(*ch));
+    if (!clone)
+        return NULL;
+
+    // Limits declared with compound literals live on the caller's stack
+    clone->min_value = accessory_arena_copy(arena, ch->min_value, sizeof(*ch->min_value));
+    clone->max_value = accessory_arena_copy(arena, ch->max_value, sizeof(*ch->max_value));
+    clone->min_step = accessory_arena_copy(arena, ch->min_step, sizeof(*ch->min_step));
+    clone->max_len = accessory_arena_copy(arena, ch->max_len, sizeof(*ch->max_len));
+    clone->max_data_len = accessory_arena_copy(arena, ch->max_data_len, sizeof(*ch->max_data_len));
+
+    if (ch->valid_values.count) {
+        clone->valid_values.values = accessory_arena_copy(
+            arena, ch->valid_values.values,
+            ch->valid_values.count * sizeof(*ch->valid_values.values)
+        );
+    }
+    if (ch->valid_values_ranges.count) {
+        clone->valid_values_ranges.ranges = accessory_arena_copy(
+            arena, ch->valid_values_ranges.ranges,
+            ch->valid_values_ranges.count * sizeof(*ch->valid_values_ranges.ranges)
+        );
+    }
+
+    homekit_characteristic_change_callback_t **next = &clone->callback;
+    for (homekit_characteristic_change_callback_t *callback = ch->callback; callback; callback = callback->next) {
+        *next = accessory_arena_copy(arena, callback, sizeof(*callback));
+        if (!*next)
+            break;
+        next = &(*next)->next;
+    }
+
+    return clone;
+}
+
+homekit_service_t *accessory_arena_service(accessory_arena_t *arena, const homekit_service_t *service) {
+    homekit_service_t *clone = accessory_arena_copy(arena, service, sizeof(*service));
+    if (!clone)
+        return NULL;
+
+    clone->characteristics = accessory_arena_copy_list(arena, (void * const *)service->characteristics);
+    clone->linked = accessory_arena_copy_list(arena, (void * const *)service->linked);
+
+    return clone;
+}
+
+homekit_accessory_t *accessory_arena_accessory(accessory_arena_t *arena, const homekit_accessory_t *accessory) {
+    homekit_accessory_t *clone = accessory_arena_copy(arena, accessory, sizeof(*accessory));
+    if (!clone)
+        return NULL;
+
+    clone->services = accessory_arena_copy_list(arena, (void * const *)accessory->services);
+
+    return clone;
+}
+
+void accessory_arena_report(accessory_arena_t *arena) {
+    printf("Accessory arena: %u of %u bytes used", (unsigned)arena->used, (unsigned)arena->size);
+    if (arena->overflow)
+        printf(", %u bytes did not fit and were allocated from heap", (unsigned)arena->overflow);
+    printf("\n");
+}
@@ -0,0 +1,7 @@
+# Component makefile for animation
+
+INC_DIRS += $(animation_ROOT)/include
+
+animation_SRC_DIR = $(animation_ROOT)/src
+
+$(eval $(call component_compile_rules,animation))
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ws2812_frame.h>
+
+// Single task that paces and renders all animations of a ws2812 strip.
+//
+// An effect renders the whole frame at its frame rate until it is replaced.
+// An overlay (e.g. identify flashing) is drawn on top of the running effect
+// every frame until its render function returns false (on a blank frame if
+// there is no effect). Effects have to repaint all pixels. time_ms is time in
+// milliseconds since the effect/overlay was set.
+
+typedef void (*animation_effect_fn)(ws2812_pixel_t *pixels, size_t count, uint32_t time_ms, void *context);
+typedef bool (*animation_overlay_fn)(ws2812_pixel_t *pixels, size_t count, uint32_t time_ms, void *context);
+
+typedef struct {
+    uint32_t frames;                // total frames rendered
+    uint32_t overruns;              // frames that took longer than frame period
+    uint16_t fps;                   // frames rendered during last second
+    uint32_t render_time_us;        // render time of the last frame
+    uint32_t max_render_time_us;
+} animation_stats_t;
+
+int animation_init(ws2812_frame_buffer_t *frame);
+
+// Sets running effect, NULL effect clears the strip once any overlay is done
+void animation_set_effect(animation_effect_fn effect, uint8_t fps, void *context);
+
+// Starts overlay, replacing a previous one. Frame rate is the higher of effect and overlay fps.
+void animation_start_overlay(animation_overlay_fn overlay, uint8_t fps, void *context);
+
+// Renders next frame right away (e.g. after effect parameters change)
+void animation_refresh();
+
+void animation_get_stats(animation_stats_t *stats);
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <animation.h>
+
+#define ANIMATION_TASK_STACK 384
+#define ANIMATION_TASK_PRIORITY 2
+
+typedef struct {
+    ws2812_frame_buffer_t *frame;
+    TaskHandle_t task;
+    SemaphoreHandle_t lock;
+
+    animation_effect_fn effect;
+    void *effect_context;
+    uint8_t effect_fps;
+    uint32_t effect_start;
+
+    animation_overlay_fn overlay;
+    void *overlay_context;
+    uint8_t overlay_fps;
+    uint32_t overlay_start;
+
+    animation_stats_t stats;
+} animation_t;
+
+static animation_t animation;
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void animation_clear() {
+    ws2812_pixel_t *pixels = ws2812_frame_begin(animation.frame);
+    memset(pixels, 0, animation.frame->count * sizeof(ws2812_pixel_t));
+    ws2812_frame_end(animation.frame);
+}
+
+static void animation_task(void *_args) {
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t second_start = time_ms();
+    uint16_t second_frames = 0;
+
+    while (true) {
+        xSemaphoreTake(animation.lock, portMAX_DELAY);
+        animation_effect_fn effect = animation.effect;
+        void *effect_context = animation.effect_context;
+        uint32_t effect_start = animation.effect_start;
+        animation_overlay_fn overlay = animation.overlay;
+        void *overlay_context = animation.overlay_context;
+        uint32_t overlay_start = animation.overlay_start;
+        uint8_t fps = animation.effect ? animation.effect_fps : 0;
+        if (animation.overlay && animation.overlay_fps > fps)
+            fps = animation.overlay_fps;
+        xSemaphoreGive(animation.lock);
+
+        if (!effect && !overlay) {
+            // Nothing to animate: blank the strip and sleep until something changes
+            animation_clear();
+            animation.stats.fps = 0;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_wake = xTaskGetTickCount();
+            continue;
+        }
+
+        uint32_t now = time_ms();
+        uint32_t start_us = sdk_system_get_time();
+
+        ws2812_pixel_t *pixels = ws2812_frame_begin(animation.frame);
+        if (effect)
+            effect(pixels, animation.frame->count, now - effect_start, effect_context);
+        else
+            memset(pixels, 0, animation.frame->count * sizeof(ws2812_pixel_t));
+        bool overlay_done = overlay && !overlay(pixels, animation.frame->count, now - overlay_start, overlay_context);
+        ws2812_frame_end(animation.frame);
+
+        uint32_t render_time_us = sdk_system_get_time() - start_us;
+
+        if (overlay_done) {
+            xSemaphoreTake(animation.lock, portMAX_DELAY);
+            if (animation.overlay == overlay && animation.overlay_context == overlay_context)
+                animation.overlay = NULL;
+            xSemaphoreGive(animation.lock);
+        }
+
+        TickType_t period = pdMS_TO_TICKS(1000 / fps);
+        if (!period)
+            period = 1;
+
+        animation.stats.frames++;
+        animation.stats.render_time_us = render_time_us;
+        if (render_time_us > animation.stats.max_render_time_us)
+            animation.stats.max_render_time_us = render_time_us;
+        if (render_time_us > period * portTICK_PERIOD_MS * 1000)
+            animation.stats.overruns++;
+
+        second_frames++;
+        if (now - second_start >= 1000) {
+            animation.stats.fps = second_frames;
+#ifdef ANIMATION_DEBUG
+            printf("Animation: %d fps (target %d), render %dus, max %dus, overruns %d\n",
+                   second_frames, fps, render_time_us,
+                   animation.stats.max_render_time_us, animation.stats.overruns);
+#endif
+            second_frames = 0;
+            second_start = now;
+        }
+
+        // Drift free pacing like vTaskDelayUntil(), but can be woken early by animation_refresh()
+        TickType_t next_wake = last_wake + period;
+        TickType_t current = xTaskGetTickCount();
+        if ((int32_t)(next_wake - current) > 0) {
+            if (ulTaskNotifyTake(pdTRUE, next_wake - current)) {
+                next_wake = xTaskGetTickCount();
+            }
+        } else {
+            // Running late, don't try to catch up with skipped frames
+            next_wake = current;
+        }
+        last_wake = next_wake;
+    }
+}
+
+int animation_init(ws2812_frame_buffer_t *frame) {
+    memset(&animation, 0, sizeof(animation));
+    animation.frame = frame;
+
+    animation.lock = xSemaphoreCreateMutex();
+    if (!animation.lock) {
+        printf("Failed to create animation lock\n");
+        return -1;
+    }
+
+    if (xTaskCreate(animation_task, "Animation", ANIMATION_TASK_STACK, NULL,
+                    ANIMATION_TASK_PRIORITY, &animation.task) != pdPASS) {
+        printf("Failed to create animation task\n");
+        vSemaphoreDelete(animation.lock);
+        animation.lock = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void animation_set_effect(animation_effect_fn effect, uint8_t fps, void *context) {
+    xSemaphoreTake(animation.lock, portMAX_DELAY);
+    animation.effect = effect;
+    animation.effect_fps = fps ? fps : 1;
+    animation.effect_context = context;
+    animation.effect_start = time_ms();
+    xSemaphoreGive(animation.lock);
+
+    animation_refresh();
+}
+
+void animation_start_overlay(animation_overlay_fn overlay, uint8_t fps, void *context) {
+    xSemaphoreTake(animation.lock, portMAX_DELAY);
+    animation.overlay = overlay;
+    animation.overlay_fps = fps ? fps : 1;
+    animation.overlay_context = context;
+    animation.overlay_start = time_ms();
+    xSemaphoreGive(animation.lock);
+
+    animation_refresh();
+}
+
+void animation_refresh() {
+    if (animation.task)
+        xTaskNotifyGive(animation.task);
+}
+
+void animation_get_stats(animation_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = animation.stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,7 @@
+# Component makefile for boot_profiler
+
+INC_DIRS += $(boot_profiler_ROOT)/include
+
+boot_profiler_SRC_DIR = $(boot_profiler_ROOT)/src
+
+$(eval $(call component_compile_rules,boot_profiler))
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot to ready latency profiler.
+//
+// Timestamps (microseconds since reset) of each boot phase are kept in RTC
+// user memory, which survives resets and deep sleep but not power loss, so
+// the last BOOT_PROFILER_HISTORY boots can be compared after the fact.
+// boot_profiler_init() prints the breakdown of previous boots,
+// boot_profiler_report() prints all of them including the current one.
+
+#ifndef BOOT_PROFILER_HISTORY
+#define BOOT_PROFILER_HISTORY 8
+#endif
+
+typedef enum {
+    boot_phase_user_init,
+    boot_phase_wifi_associated,
+    boot_phase_got_ip,
+    boot_phase_homekit_init,        // homekit_server_init() called
+    boot_phase_server_ready,        // HOMEKIT_EVENT_SERVER_INITIALIZED, mDNS announced
+    boot_phase_first_verify,        // HOMEKIT_EVENT_CLIENT_VERIFIED, first pair verify
+    boot_phase_count,
+} boot_phase_t;
+
+typedef struct {
+    uint32_t reset_reason;
+    uint32_t time[boot_phase_count];    // 0 if the phase wasn't reached
+} boot_profiler_record_t;
+
+// Call first thing in user_init(), marks boot_phase_user_init
+void boot_profiler_init();
+
+// Records the current time for phase unless it was already recorded this
+// boot. Returns true if it was recorded. Safe to call from any task and
+// from SDK callbacks, doesn't block.
+bool boot_profiler_mark(boot_phase_t phase);
+
+// Copies record of the index'th most recent boot (0 is the current one).
+// Returns -1 if there is no such record.
+int boot_profiler_get(uint8_t index, boot_profiler_record_t *record);
+
+void boot_profiler_report();
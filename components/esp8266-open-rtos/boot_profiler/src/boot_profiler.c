@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <boot_profiler.h>
+
+// RTC user memory is addressed in 4 byte blocks, 64 to 191
+#ifndef BOOT_PROFILER_RTC_BLOCK
+#define BOOT_PROFILER_RTC_BLOCK 64
+#endif
+
+#define BOOT_PROFILER_RTC_END 192
+
+// Layout changes invalidate records of the old layout
+#define BOOT_PROFILER_MAGIC (0xB0070000 | (BOOT_PROFILER_HISTORY << 8) | boot_phase_count)
+
+#define BOOT_PROFILER_HEADER_BLOCKS (sizeof(boot_profiler_header_t) / 4)
+#define BOOT_PROFILER_RECORD_BLOCKS (sizeof(boot_profiler_record_t) / 4)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t boots;                 // boots recorded since RTC memory was lost
+} boot_profiler_header_t;
+
+_Static_assert(BOOT_PROFILER_RTC_BLOCK >= 64, "RTC user memory starts at block 64");
+_Static_assert(BOOT_PROFILER_RTC_BLOCK + sizeof(boot_profiler_header_t) / 4 +
+               BOOT_PROFILER_HISTORY * sizeof(boot_profiler_record_t) / 4 <= BOOT_PROFILER_RTC_END,
+               "BOOT_PROFILER_HISTORY does not fit into RTC user memory");
+
+static const char *boot_phase_names[boot_phase_count] = {
+    "user_init", "associated", "got_ip", "homekit", "server", "verify",
+};
+
+typedef struct {
+    boot_profiler_header_t header;
+    boot_profiler_record_t current;
+    uint8_t current_block;
+} boot_profiler_t;
+
+static boot_profiler_t profiler;
+
+static uint8_t boot_profiler_record_block(uint32_t boot) {
+    return BOOT_PROFILER_RTC_BLOCK + BOOT_PROFILER_HEADER_BLOCKS +
+           ((boot - 1) % BOOT_PROFILER_HISTORY) * BOOT_PROFILER_RECORD_BLOCKS;
+}
+
+void boot_profiler_init() {
+    uint32_t now = sdk_system_get_time();
+
+    if (!sdk_system_rtc_mem_read(BOOT_PROFILER_RTC_BLOCK, &profiler.header, sizeof(profiler.header)) ||
+            profiler.header.magic != BOOT_PROFILER_MAGIC) {
+        // Power on, RTC memory holds garbage
+        profiler.header.magic = BOOT_PROFILER_MAGIC;
+        profiler.header.boots = 0;
+    }
+
+    if (profiler.header.boots)
+        boot_profiler_report();
+
+    profiler.header.boots++;
+    profiler.current_block = boot_profiler_record_block(profiler.header.boots);
+
+    memset(&profiler.current, 0, sizeof(profiler.current));
+    profiler.current.reset_reason = sdk_system_get_rst_info()->reason;
+    profiler.current.time[boot_phase_user_init] = now;
+
+    sdk_system_rtc_mem_write(profiler.current_block, &profiler.current, sizeof(profiler.current));
+    sdk_system_rtc_mem_write(BOOT_PROFILER_RTC_BLOCK, &profiler.header, sizeof(profiler.header));
+}
+
+bool boot_profiler_mark(boot_phase_t phase) {
+    if (!profiler.header.boots || phase >= boot_phase_count)
+        return false;
+
+    uint32_t now = sdk_system_get_time();
+    if (!now)
+        now = 1;
+
+    taskENTER_CRITICAL();
+    bool first = !profiler.current.time[phase];
+    if (first)
+        profiler.current.time[phase] = now;
+    taskEXIT_CRITICAL();
+
+    if (!first)
+        return false;
+
+    // Only the word of this phase, so concurrent marks don't overwrite each other
+    sdk_system_rtc_mem_write(profiler.current_block + 1 + phase, &now, sizeof(now));
+    return true;
+}
+
+int boot_profiler_get(uint8_t index, boot_profiler_record_t *record) {
+    if (index >= BOOT_PROFILER_HISTORY || index >= profiler.header.boots)
+        return -1;
+
+    if (!sdk_system_rtc_mem_read(boot_profiler_record_block(profiler.header.boots - index),
+                                 record, sizeof(*record))) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void boot_profiler_print_time(uint32_t time_us) {
+    printf(" %7u.%u", time_us / 1000, (time_us % 1000) / 100);
+}
+
+void boot_profiler_report() {
+    printf("Boot phases, ms after previous phase (- not reached):\n");
+    printf("  boot reset");
+    for (int i = 0; i < boot_phase_count; i++)
+        printf(" %9s", boot_phase_names[i]);
+    printf("     total\n");
+
+    boot_profiler_record_t record;
+    for (int i = BOOT_PROFILER_HISTORY - 1; i >= 0; i--) {
+        if (boot_profiler_get(i, &record))
+            continue;
+
+        printf("%6u %5u", profiler.header.boots - i, record.reset_reason);
+
+        // user_init is relative to reset, the rest to the last phase reached
+        uint32_t last = 0;
+        for (int phase = 0; phase < boot_phase_count; phase++) {
+            if (!record.time[phase] || record.time[phase] < last) {
+                printf(" %9s", "-");
+                continue;
+            }
+
+            boot_profiler_print_time(record.time[phase] - last);
+            last = record.time[phase];
+        }
+        boot_profiler_print_time(last);
+        printf("\n");
+    }
+}
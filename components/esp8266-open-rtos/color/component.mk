@@ -0,0 +1,7 @@
+# Component makefile for color
+
+INC_DIRS += $(color_ROOT)/include
+
+color_SRC_DIR = $(color_ROOT)/src
+
+$(eval $(call component_compile_rules,color))
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#define COLOR_FLAG_SHAPE_INTENSITY 0x01  // apply i*sqrt(i) curve for finer granularity near 0
+
+typedef struct {
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+    uint16_t white;
+} color_rgbw_t;
+
+// Intensity in percent (clamped to 100) converted to range [0, scale].
+uint16_t color_intensity(uint8_t intensity, uint16_t scale, uint8_t flags);
+
+// Integer HSI to RGB conversion
+// (http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white).
+// Hue is in degrees (wraps around 360), saturation and intensity are in percent
+// (clamped to 100). Output channels are in range [0, scale], white is always 0.
+void color_hsi2rgb(uint16_t hue, uint8_t saturation, uint8_t intensity,
+                   uint16_t scale, uint8_t flags, color_rgbw_t *rgb);
+
+// Same as color_hsi2rgb(), but the desaturated part of the color is moved
+// to the white channel instead of being mixed from red, green and blue.
+void color_hsi2rgbw(uint16_t hue, uint8_t saturation, uint8_t intensity,
+                    uint16_t scale, uint8_t flags, color_rgbw_t *rgbw);
@@ -0,0 +1,130 @@
+#include <color.h>
+
+#define Q16_ONE   65535
+#define Q16_THIRD 21845
+
+// cos(h)/cos(60 - h)/3 in Q16 for each degree of a 120 degree sector.
+// Word sized entries so the table can be read straight from flash.
+static const int32_t sector_lut[120] = {
+    43691, 42409, 41199, 40055, 38971, 37941, 36962, 36029,
+    35137, 34285, 33469, 32686, 31934, 31210, 30513, 29841,
+    29192, 28565, 27957, 27368, 26797, 26243, 25704, 25179,
+    24668, 24170, 23683, 23209, 22744, 22290, 21845, 21409,
+    20982, 20562, 20150, 19745, 19346, 18953, 18566, 18185,
+    17808, 17437, 17070, 16707, 16347, 15992, 15640, 15290,
+    14944, 14600, 14259, 13919, 13582, 13246, 12911, 12578,
+    12246, 11914, 11583, 11253, 10923, 10592, 10262, 9931,
+    9600, 9268, 8934, 8600, 8264, 7926, 7587, 7245,
+    6901, 6555, 6206, 5853, 5498, 5139, 4776, 4408,
+    4037, 3660, 3279, 2892, 2500, 2101, 1695, 1283,
+    863, 436, 0, -445, -899, -1363, -1838, -2324,
+    -2823, -3334, -3858, -4397, -4952, -5523, -6112, -6719,
+    -7347, -7996, -8668, -9365, -10089, -10841, -11624, -12440,
+    -13292, -14183, -15117, -16096, -17125, -18209, -19353, -20563,
+};
+
+// (i/100)^1.5 in Q16
+static const uint32_t shaped_intensity_lut[101] = {
+    0, 66, 185, 341, 524, 733, 963, 1214,
+    1483, 1769, 2072, 2391, 2724, 3072, 3433, 3807,
+    4194, 4594, 5005, 5428, 5862, 6307, 6763, 7229,
+    7705, 8192, 8688, 9194, 9710, 10235, 10768, 11311,
+    11863, 12424, 12992, 13570, 14156, 14749, 15351, 15961,
+    16579, 17205, 17838, 18479, 19127, 19783, 20446, 21116,
+    21794, 22479, 23170, 23869, 24574, 25286, 26005, 26731,
+    27463, 28202, 28948, 29700, 30458, 31223, 31993, 32771,
+    33554, 34343, 35139, 35941, 36748, 37562, 38381, 39207,
+    40038, 40875, 41718, 42566, 43420, 44280, 45146, 46017,
+    46893, 47775, 48662, 49555, 50454, 51357, 52266, 53180,
+    54100, 55025, 55955, 56890, 57830, 58776, 59726, 60682,
+    61642, 62608, 63579, 64554, 65535,
+};
+
+static inline uint32_t percent_to_q16(uint8_t percent) {
+    // percent * 65535 / 100 without a division
+    return ((uint32_t)percent * 167772) >> 8;
+}
+
+static inline int32_t percent_to_q15(uint8_t percent) {
+    return ((int32_t)percent * 83887) >> 8;
+}
+
+static inline uint16_t scale_channel(uint32_t intensity, uint32_t factor, uint16_t scale) {
+    uint32_t f = (intensity * (factor > Q16_ONE ? Q16_ONE : factor)) >> 16;
+    return (f * scale + 32768) >> 16;
+}
+
+static void assign_sector(uint16_t sector, uint16_t a, uint16_t b, uint16_t c, color_rgbw_t *rgb) {
+    switch (sector) {
+        case 0:
+            rgb->red = a; rgb->green = b; rgb->blue = c;
+            break;
+        case 1:
+            rgb->green = a; rgb->blue = b; rgb->red = c;
+            break;
+        default:
+            rgb->blue = a; rgb->red = b; rgb->green = c;
+            break;
+    }
+}
+
+static uint32_t intensity_q16(uint8_t intensity, uint8_t flags) {
+    if (intensity > 100)
+        intensity = 100;
+
+    if (flags & COLOR_FLAG_SHAPE_INTENSITY)
+        return shaped_intensity_lut[intensity];
+
+    return percent_to_q16(intensity);
+}
+
+uint16_t color_intensity(uint8_t intensity, uint16_t scale, uint8_t flags) {
+    return (intensity_q16(intensity, flags) * scale + 32768) >> 16;
+}
+
+void color_hsi2rgb(uint16_t hue, uint8_t saturation, uint8_t intensity,
+                   uint16_t scale, uint8_t flags, color_rgbw_t *rgb) {
+    hue %= 360;
+    uint16_t sector = hue / 120;
+    int32_t ratio = sector_lut[hue - sector * 120];
+
+    if (saturation > 100)
+        saturation = 100;
+    int32_t s = percent_to_q15(saturation);
+    uint32_t i = intensity_q16(intensity, flags);
+
+    // i/3 * (1 + s * cos(h)/cos(60 - h)), i/3 * (1 + s * (1 - cos(h)/cos(60 - h))), i/3 * (1 - s)
+    int32_t a = Q16_THIRD + ((s * ratio) >> 15);
+    int32_t b = Q16_THIRD + ((s * (Q16_THIRD - ratio)) >> 15);
+    int32_t c = Q16_THIRD - ((s * Q16_THIRD) >> 15);
+
+    assign_sector(sector,
+                  scale_channel(i, a > 0 ? a : 0, scale),
+                  scale_channel(i, b > 0 ? b : 0, scale),
+                  scale_channel(i, c > 0 ? c : 0, scale),
+                  rgb);
+    rgb->white = 0;
+}
+
+void color_hsi2rgbw(uint16_t hue, uint8_t saturation, uint8_t intensity,
+                    uint16_t scale, uint8_t flags, color_rgbw_t *rgbw) {
+    hue %= 360;
+    uint16_t sector = hue / 120;
+    int32_t ratio = sector_lut[hue - sector * 120];
+
+    if (saturation > 100)
+        saturation = 100;
+    int32_t s = percent_to_q15(saturation);
+    uint32_t i = intensity_q16(intensity, flags);
+
+    // s*i/3 * (1 + cos(h)/cos(60 - h)), s*i/3 * (1 + (1 - cos(h)/cos(60 - h))), 0, (1 - s) * i
+    int32_t a = ((s * Q16_THIRD) >> 15) + ((s * ratio) >> 15);
+    int32_t b = ((s * 2 * Q16_THIRD) >> 15) - ((s * ratio) >> 15);
+
+    assign_sector(sector,
+                  scale_channel(i, a > 0 ? a : 0, scale),
+                  scale_channel(i, b > 0 ? b : 0, scale),
+                  0,
+                  rgbw);
+    rgbw->white = scale_channel(i, 65536 - 2 * s, scale);
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <color.h>
+
+#include "hsi2rgb_float.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+// Cost per conversion of the color component and of the float code it
+// replaced, sweeping every integer hue, saturation and intensity. The host
+// has a hardware FPU, so the gap is much smaller than on the ESP8266 where
+// float math is emulated; use the numbers to compare the two, not as
+// absolute timings for the device.
+
+#define ROUNDS 4
+#define CONVERSIONS ((uint32_t)ROUNDS * 360 * 101 * 101)
+
+static volatile int sink;
+
+typedef void (*convert_fn)(uint16_t h, uint8_t s, uint8_t i);
+
+static void convert_fixed_rgb(uint16_t h, uint8_t s, uint8_t i) {
+    color_rgbw_t color;
+    color_hsi2rgb(h, s, i, 255, COLOR_FLAG_SHAPE_INTENSITY, &color);
+    sink = color.red + color.green + color.blue;
+}
+
+static void convert_fixed_rgbw(uint16_t h, uint8_t s, uint8_t i) {
+    color_rgbw_t color;
+    color_hsi2rgbw(h, s, i, 4095, COLOR_FLAG_SHAPE_INTENSITY, &color);
+    sink = color.red + color.green + color.blue + color.white;
+}
+
+static void convert_float_rgb(uint16_t h, uint8_t s, uint8_t i) {
+    int rgb[3];
+    hsi2rgb_float(h, s, i, 255, 1, rgb);
+    sink = rgb[0] + rgb[1] + rgb[2];
+}
+
+static void convert_float_rgbw(uint16_t h, uint8_t s, uint8_t i) {
+    int rgbw[4];
+    hsi2rgbw_float(h, s, i, 4095, 1, rgbw);
+    sink = rgbw[0] + rgbw[1] + rgbw[2] + rgbw[3];
+}
+
+static uint64_t time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench(const char *name, convert_fn convert) {
+    uint64_t start = time_ns();
+#ifdef HAVE_CYCLES
+    uint64_t start_cycles = __rdtsc();
+#endif
+
+    for (int round = 0; round < ROUNDS; round++)
+        for (uint16_t h = 0; h < 360; h++)
+            for (uint8_t s = 0; s <= 100; s++)
+                for (uint8_t i = 0; i <= 100; i++)
+                    convert(h, s, i);
+
+#ifdef HAVE_CYCLES
+    double cycles = (double)(__rdtsc() - start_cycles) / CONVERSIONS;
+#endif
+    double ns = (double)(time_ns() - start) / CONVERSIONS;
+
+#ifdef HAVE_CYCLES
+    printf("%-12s %7.1f ns %7.1f cycles per conversion\n", name, ns, cycles);
+#else
+    printf("%-12s %7.1f ns per conversion\n", name, ns);
+#endif
+}
+
+int main() {
+    bench("float rgb", convert_float_rgb);
+    bench("fixed rgb", convert_fixed_rgb);
+    bench("float rgbw", convert_float_rgbw);
+    bench("fixed rgbw", convert_fixed_rgbw);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <math.h>
+
+// Float conversions the color component replaced, taken from
+// examples/led_strip (RGB) and examples/ZemiSmart (RGBW) with the output
+// scale made a parameter. Kept as the reference for accuracy and speed.
+
+//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
+static void hsi2rgb_float(float h, float s, float i, float scale, int shape, int *rgb) {
+    int r, g, b;
+
+    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
+    while (h >= 360) { h -= 360.0F; };
+    h = 3.14159F*h / 180.0F;            // convert to radians.
+    s /= 100.0F;                        // from percentage to ratio
+    i /= 100.0F;                        // from percentage to ratio
+    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
+    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
+    if (shape)
+        i = i * sqrt(i);                // shape intensity to have finer granularity near 0
+
+    if (h < 2.09439) {
+        r = scale * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
+        g = scale * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
+        b = scale * i / 3 * (1 - s);
+    }
+    else if (h < 4.188787) {
+        h = h - 2.09439;
+        g = scale * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
+        b = scale * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
+        r = scale * i / 3 * (1 - s);
+    }
+    else {
+        h = h - 4.188787;
+        b = scale * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
+        r = scale * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
+        g = scale * i / 3 * (1 - s);
+    }
+
+    rgb[0] = r;
+    rgb[1] = g;
+    rgb[2] = b;
+}
+
+static void hsi2rgbw_float(float h, float s, float i, float scale, int shape, int *rgbw) {
+    int r, g, b, w;
+    float cos_h, cos_1047_h;
+    h = 3.14159*h/(float)180; // Convert to radians.
+    s /=(float)100; i/=(float)100; //from percentage to ratio
+    s = s>0?(s<1?s:1):0; // clamp s and i to interval [0,1]
+    i = i>0?(i<1?i:1):0;
+    if (shape)
+        i = i*sqrt(i); //shape intensity to have finer granularity near 0
+
+    if(h < 2.09439) {
+        cos_h = cos(h);
+        cos_1047_h = cos(1.047196667-h);
+        r = s*scale*i/3*(1+cos_h/cos_1047_h);
+        g = s*scale*i/3*(1+(1-cos_h/cos_1047_h));
+        b = 0;
+        w = scale*(1-s)*i;
+    } else if(h < 4.188787) {
+        h = h - 2.09439;
+        cos_h = cos(h);
+        cos_1047_h = cos(1.047196667-h);
+        g = s*scale*i/3*(1+cos_h/cos_1047_h);
+        b = s*scale*i/3*(1+(1-cos_h/cos_1047_h));
+        r = 0;
+        w = scale*(1-s)*i;
+    } else {
+        h = h - 4.188787;
+        cos_h = cos(h);
+        cos_1047_h = cos(1.047196667-h);
+        b = s*scale*i/3*(1+cos_h/cos_1047_h);
+        r = s*scale*i/3*(1+(1-cos_h/cos_1047_h));
+        g = 0;
+        w = scale*(1-s)*i;
+    }
+
+    rgbw[0]=r;
+    rgbw[1]=g;
+    rgbw[2]=b;
+    rgbw[3]=w;
+}
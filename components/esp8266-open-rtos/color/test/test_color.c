@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <color.h>
+
+#include "hsi2rgb_float.h"
+
+// Compares the color component with the float code it replaced over every
+// integer hue, saturation and intensity. The float code truncates, the
+// component rounds, so outputs may differ by one step.
+#define MAX_ERROR 1
+
+static int failures = 0;
+
+static void check(const char *name, uint16_t scale, uint8_t flags,
+                  uint16_t h, uint8_t s, uint8_t i, const int *expected, const color_rgbw_t *actual, int channels) {
+    const int values[4] = { actual->red, actual->green, actual->blue, actual->white };
+    for (int c = 0; c < channels; c++) {
+        if (abs(values[c] - expected[c]) <= MAX_ERROR)
+            continue;
+
+        if (failures++ < 10) {
+            printf("%s scale %u flags %u: h %u s %u i %u channel %d: got %d, expected %d\n",
+                   name, scale, flags, h, s, i, c, values[c], expected[c]);
+        }
+    }
+}
+
+static void test_scale(uint16_t scale, uint8_t flags) {
+    int max_error = 0;
+
+    for (uint16_t h = 0; h < 360; h++) {
+        for (uint8_t s = 0; s <= 100; s++) {
+            for (uint8_t i = 0; i <= 100; i++) {
+                int expected[4];
+                color_rgbw_t actual;
+
+                hsi2rgb_float(h, s, i, scale, flags & COLOR_FLAG_SHAPE_INTENSITY, expected);
+                color_hsi2rgb(h, s, i, scale, flags, &actual);
+                check("rgb", scale, flags, h, s, i, expected, &actual, 3);
+                if (actual.white) {
+                    printf("rgb scale %u: h %u s %u i %u: white is %u\n", scale, h, s, i, actual.white);
+                    failures++;
+                }
+                for (int c = 0; c < 3; c++) {
+                    int e = abs((&actual.red)[c] - expected[c]);
+                    if (e > max_error)
+                        max_error = e;
+                }
+
+                hsi2rgbw_float(h, s, i, scale, flags & COLOR_FLAG_SHAPE_INTENSITY, expected);
+                color_hsi2rgbw(h, s, i, scale, flags, &actual);
+                check("rgbw", scale, flags, h, s, i, expected, &actual, 4);
+                for (int c = 0; c < 4; c++) {
+                    int e = abs((&actual.red)[c] - expected[c]);
+                    if (e > max_error)
+                        max_error = e;
+                }
+            }
+        }
+    }
+
+    printf("scale %4u flags %u: max error %d\n", scale, flags, max_error);
+}
+
+int main() {
+    test_scale(255, COLOR_FLAG_SHAPE_INTENSITY);
+    test_scale(255, 0);
+    test_scale(4095, COLOR_FLAG_SHAPE_INTENSITY);
+    test_scale(4095, 0);
+
+    // Hue wraps around, saturation and intensity are clamped
+    color_rgbw_t a, b;
+    color_hsi2rgb(30, 100, 100, 255, 0, &a);
+    color_hsi2rgb(390, 150, 200, 255, 0, &b);
+    if (a.red != b.red || a.green != b.green || a.blue != b.blue) {
+        printf("hue wrap or clamping mismatch\n");
+        failures++;
+    }
+
+    if (failures) {
+        printf("FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,7 @@
+# Component makefile for deferred_log
+
+INC_DIRS += $(deferred_log_ROOT)/include
+
+deferred_log_SRC_DIR = $(deferred_log_ROOT)/src
+
+$(eval $(call component_compile_rules,deferred_log))
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+// Deferred logging for hot paths and interrupt handlers.
+//
+// A log call only stores the format string pointer and up to
+// DEFERRED_LOG_MAX_ARGS raw arguments in a RAM ring buffer, which takes
+// a few microseconds and never waits for the UART. A low priority task
+// formats and prints the records later. With DEFERRED_LOG_BINARY defined
+// it writes them as binary frames instead, to be decoded on the host
+// using format strings from the ELF file:
+//
+//   0xA5 0x5A, format address (4), time in us (4), level (1), argc (1),
+//   argc arguments (4 each), all little endian
+//
+// Arguments are stored as 32 bit words, so only integers, chars and
+// pointers to strings that stay valid (literals) can be logged. Floats
+// are truncated to integers.
+//
+// Each source file can set its own name and level before including:
+//
+//   #define DLOG_MODULE "garage"
+//   #define DLOG_LEVEL DLOG_LEVEL_DEBUG
+//   #include <deferred_log.h>
+//
+// Calls above DLOG_LEVEL are compiled out.
+
+#define DLOG_LEVEL_NONE 0
+#define DLOG_LEVEL_ERROR 1
+#define DLOG_LEVEL_WARN 2
+#define DLOG_LEVEL_INFO 3
+#define DLOG_LEVEL_DEBUG 4
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_LEVEL_INFO
+#endif
+
+#ifndef DLOG_MODULE
+#define DLOG_MODULE "app"
+#endif
+
+#ifndef DEFERRED_LOG_SIZE
+#define DEFERRED_LOG_SIZE 32        // records, 28 bytes each
+#endif
+
+#define DEFERRED_LOG_MAX_ARGS 4
+
+typedef struct {
+    uint32_t written;
+    uint32_t dropped;               // ring buffer was full
+    uint8_t max_pending;
+} deferred_log_stats_t;
+
+int deferred_log_init();
+
+void deferred_log_write(uint8_t level, const char *format, uint8_t argc,
+                        uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+void deferred_log_get_stats(deferred_log_stats_t *stats);
+
+#define DLOG_ERROR(format, ...) _DLOG(DLOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define DLOG_WARN(format, ...) _DLOG(DLOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define DLOG_INFO(format, ...) _DLOG(DLOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define DLOG_DEBUG(format, ...) _DLOG(DLOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+
+#define _DLOG(level, format, ...) \
+    do { \
+        if ((level) <= DLOG_LEVEL) \
+            deferred_log_write((level), DLOG_MODULE ": " format, _DLOG_NARGS(__VA_ARGS__), \
+                               _DLOG_CAT(_DLOG_ARGS_, _DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)); \
+    } while (0)
+
+#define _DLOG_CAT(a, b) _DLOG_CAT_(a, b)
+#define _DLOG_CAT_(a, b) a ## b
+
+#define _DLOG_NARGS(...) _DLOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define _DLOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+
+#define _DLOG_ARG(x) ((uint32_t)(uintptr_t)(x))
+#define _DLOG_ARGS_0() 0, 0, 0, 0
+#define _DLOG_ARGS_1(a) _DLOG_ARG(a), 0, 0, 0
+#define _DLOG_ARGS_2(a, b) _DLOG_ARG(a), _DLOG_ARG(b), 0, 0
+#define _DLOG_ARGS_3(a, b, c) _DLOG_ARG(a), _DLOG_ARG(b), _DLOG_ARG(c), 0
+#define _DLOG_ARGS_4(a, b, c, d) _DLOG_ARG(a), _DLOG_ARG(b), _DLOG_ARG(c), _DLOG_ARG(d)
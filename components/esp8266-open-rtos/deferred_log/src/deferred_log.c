@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <espressif/esp_system.h>
+#include <esp/interrupts.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <deferred_log.h>
+
+#define DEFERRED_LOG_TASK_STACK 384
+#define DEFERRED_LOG_TASK_PRIORITY 1
+
+// How often (in milliseconds) the task checks for new records
+#define DEFERRED_LOG_DRAIN_PERIOD 50
+
+typedef struct {
+    const char *format;
+    uint32_t time;
+    uint8_t level;
+    uint8_t argc;
+    volatile uint8_t ready;
+    uint32_t args[DEFERRED_LOG_MAX_ARGS];
+} deferred_log_record_t;
+
+typedef struct {
+    deferred_log_record_t records[DEFERRED_LOG_SIZE];
+
+    // Free running counters, head is only changed with interrupts
+    // disabled (writers can be interrupt handlers), tail only by the task
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    TaskHandle_t task;
+    deferred_log_stats_t stats;
+} deferred_log_t;
+
+static deferred_log_t deferred_log;
+
+void deferred_log_write(uint8_t level, const char *format, uint8_t argc,
+                        uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    uint32_t time = sdk_system_get_time();
+
+    uint32_t state = _xt_disable_interrupts();
+    uint32_t index = deferred_log.head;
+    uint32_t pending = index - deferred_log.tail;
+    if (pending >= DEFERRED_LOG_SIZE) {
+        deferred_log.stats.dropped++;
+        _xt_restore_interrupts(state);
+        return;
+    }
+    deferred_log.head = index + 1;
+    deferred_log.stats.written++;
+    if (pending + 1 > deferred_log.stats.max_pending)
+        deferred_log.stats.max_pending = pending + 1;
+    _xt_restore_interrupts(state);
+
+    // Slot is reserved, fill it in without blocking other writers
+    deferred_log_record_t *record = &deferred_log.records[index % DEFERRED_LOG_SIZE];
+    record->format = format;
+    record->time = time;
+    record->level = level;
+    record->argc = argc;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    record->args[3] = arg3;
+    __asm__ volatile ("" ::: "memory");
+    record->ready = 1;
+}
+
+#ifdef DEFERRED_LOG_BINARY
+
+static void deferred_log_put_word(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        uart_putc(0, value & 0xff);
+        value >>= 8;
+    }
+}
+
+static void deferred_log_output(deferred_log_record_t *record) {
+    uart_putc(0, 0xA5);
+    uart_putc(0, 0x5A);
+    deferred_log_put_word((uint32_t)(uintptr_t)record->format);
+    deferred_log_put_word(record->time);
+    uart_putc(0, record->level);
+    uart_putc(0, record->argc);
+    for (int i = 0; i < record->argc; i++)
+        deferred_log_put_word(record->args[i]);
+}
+
+#else
+
+static void deferred_log_output(deferred_log_record_t *record) {
+    uint32_t time_ms = record->time / 1000;
+    printf("[%u.%03u] ", time_ms / 1000, time_ms % 1000);
+    printf(record->format, record->args[0], record->args[1], record->args[2], record->args[3]);
+}
+
+#endif
+
+static void deferred_log_task(void *_args) {
+#ifndef DEFERRED_LOG_BINARY
+    uint32_t dropped = 0;
+#endif
+
+    while (true) {
+        while (deferred_log.tail != deferred_log.head) {
+            deferred_log_record_t *record = &deferred_log.records[deferred_log.tail % DEFERRED_LOG_SIZE];
+            if (!record->ready) {
+                // Reserved, but writer was preempted before filling it in
+                break;
+            }
+            __asm__ volatile ("" ::: "memory");
+
+            deferred_log_output(record);
+
+            record->ready = 0;
+            deferred_log.tail++;
+        }
+
+#ifndef DEFERRED_LOG_BINARY
+        if (deferred_log.stats.dropped != dropped) {
+            printf("deferred_log: %u messages dropped\n", deferred_log.stats.dropped - dropped);
+            dropped = deferred_log.stats.dropped;
+        }
+#endif
+
+        vTaskDelay(pdMS_TO_TICKS(DEFERRED_LOG_DRAIN_PERIOD));
+    }
+}
+
+int deferred_log_init() {
+    if (deferred_log.task)
+        return 0;
+
+    if (xTaskCreate(deferred_log_task, "Log", DEFERRED_LOG_TASK_STACK, NULL,
+                    DEFERRED_LOG_TASK_PRIORITY, &deferred_log.task) != pdPASS) {
+        printf("Failed to create log task\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void deferred_log_get_stats(deferred_log_stats_t *stats) {
+    uint32_t state = _xt_disable_interrupts();
+    *stats = deferred_log.stats;
+    _xt_restore_interrupts(state);
+}
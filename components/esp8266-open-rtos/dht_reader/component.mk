@@ -0,0 +1,7 @@
+# Component makefile for dht_reader
+
+INC_DIRS += $(dht_reader_ROOT)/include
+
+dht_reader_SRC_DIR = $(dht_reader_ROOT)/src
+
+$(eval $(call component_compile_rules,dht_reader))
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// DHT11/DHT22 reader that doesn't disable interrupts.
+//
+// The start signal is timed with a task delay and the sensor response is
+// captured by a falling edge interrupt that only timestamps each edge. Bits
+// are decoded from the time between falling edges afterwards, so the only
+// time spent with interrupts blocked is the few microseconds of each ISR.
+// Failed reads (timeouts, checksum errors) are retried with a doubling
+// back off. Only one sensor is read at a time.
+
+typedef enum {
+    DHT_READER_DHT11,
+    DHT_READER_DHT22,
+} dht_reader_type_t;
+
+typedef struct {
+    uint32_t reads;                 // successful reads
+    uint32_t failures;              // reads that failed after all retries
+    uint32_t retries;
+    uint32_t timeouts;              // attempts with missing edges
+    uint32_t checksum_errors;       // attempts with bad checksum or framing
+
+    uint32_t latency_ms;            // duration of last read including retries
+    uint32_t max_latency_ms;
+    uint32_t isr_time_us;           // time spent in the edge ISR during last attempt
+    uint32_t max_isr_time_us;
+} dht_reader_stats_t;
+
+typedef struct {
+    uint8_t gpio_num;
+    dht_reader_type_t type;
+
+    uint8_t retries;                // extra attempts after a failed read
+    uint16_t backoff;               // delay before first retry, in milliseconds
+
+    dht_reader_stats_t stats;
+} dht_reader_t;
+
+int dht_reader_init(dht_reader_t *reader, uint8_t gpio_num, dht_reader_type_t type);
+
+// Blocks the calling task (not interrupts) until the read is done.
+bool dht_reader_read(dht_reader_t *reader, float *humidity, float *temperature);
+
+void dht_reader_get_stats(dht_reader_t *reader, dht_reader_stats_t *stats);
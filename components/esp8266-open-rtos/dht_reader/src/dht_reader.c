@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_system.h>
+#include <espressif/esp_misc.h>
+#include <esp/gpio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <dht_reader.h>
+
+// Falling edges of a frame: start of the response, start of the first bit,
+// then the end of each of the 40 data bits.
+#define DHT_READER_EDGES 42
+
+// A bit is 50us low followed by 26-28us (0) or 70us (1) high
+#define DHT_READER_BIT_THRESHOLD_US 100
+// Response is 80us low + 80us high
+#define DHT_READER_RESPONSE_MIN_US 120
+#define DHT_READER_RESPONSE_MAX_US 220
+
+// Whole frame takes about 5ms
+#define DHT_READER_FRAME_TIMEOUT_MS 10
+
+#define DHT_READER_DEFAULT_RETRIES 2
+#define DHT_READER_DEFAULT_BACKOFF 1000
+
+typedef struct {
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+
+    volatile uint8_t count;
+    volatile uint32_t edges[DHT_READER_EDGES];
+    volatile uint32_t isr_time_us;
+} dht_reader_capture_t;
+
+static dht_reader_capture_t capture;
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void dht_reader_intr(uint8_t gpio_num) {
+    uint32_t now = sdk_system_get_time();
+
+    uint8_t count = capture.count;
+    if (count < DHT_READER_EDGES) {
+        capture.edges[count++] = now;
+        capture.count = count;
+    }
+
+    BaseType_t woken = pdFALSE;
+    if (count == DHT_READER_EDGES) {
+        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_NONE, NULL);
+        vTaskNotifyGiveFromISR(capture.task, &woken);
+    }
+
+    capture.isr_time_us += sdk_system_get_time() - now;
+
+    portEND_SWITCHING_ISR(woken);
+}
+
+typedef enum {
+    dht_reader_ok,
+    dht_reader_timeout,
+    dht_reader_bad_data,
+} dht_reader_result_t;
+
+static dht_reader_result_t dht_reader_capture(dht_reader_t *reader, uint8_t data[5]) {
+    capture.task = xTaskGetCurrentTaskHandle();
+    capture.count = 0;
+    capture.isr_time_us = 0;
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // Start signal: DHT11 needs at least 18ms low, DHT22 about 1ms
+    gpio_write(reader->gpio_num, 0);
+    if (reader->type == DHT_READER_DHT11) {
+        vTaskDelay(pdMS_TO_TICKS(20) + 1);
+    } else {
+        sdk_os_delay_us(1100);
+    }
+
+    gpio_set_interrupt(reader->gpio_num, GPIO_INTTYPE_EDGE_NEG, dht_reader_intr);
+    gpio_write(reader->gpio_num, 1);
+
+    bool complete = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DHT_READER_FRAME_TIMEOUT_MS) + 1);
+
+    gpio_set_interrupt(reader->gpio_num, GPIO_INTTYPE_NONE, NULL);
+
+    uint32_t isr_time_us = capture.isr_time_us;
+    reader->stats.isr_time_us = isr_time_us;
+    if (isr_time_us > reader->stats.max_isr_time_us)
+        reader->stats.max_isr_time_us = isr_time_us;
+
+    if (!complete)
+        return dht_reader_timeout;
+
+    uint32_t response = capture.edges[1] - capture.edges[0];
+    if (response < DHT_READER_RESPONSE_MIN_US || response > DHT_READER_RESPONSE_MAX_US)
+        return dht_reader_bad_data;
+
+    memset(data, 0, 5);
+    for (int i = 0; i < 40; i++) {
+        uint32_t period = capture.edges[i+2] - capture.edges[i+1];
+        if (period > DHT_READER_BIT_THRESHOLD_US)
+            data[i/8] |= 1 << (7 - i%8);
+    }
+
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xff) != data[4])
+        return dht_reader_bad_data;
+
+    return dht_reader_ok;
+}
+
+static void dht_reader_decode(dht_reader_t *reader, uint8_t data[5], float *humidity, float *temperature) {
+    if (reader->type == DHT_READER_DHT11) {
+        *humidity = data[0];
+        *temperature = data[2];
+    } else {
+        *humidity = ((data[0] << 8) | data[1]) / 10.0;
+        *temperature = (((data[2] & 0x7f) << 8) | data[3]) / 10.0;
+        if (data[2] & 0x80)
+            *temperature = -*temperature;
+    }
+}
+
+int dht_reader_init(dht_reader_t *reader, uint8_t gpio_num, dht_reader_type_t type) {
+    if (!capture.lock) {
+        capture.lock = xSemaphoreCreateMutex();
+        if (!capture.lock) {
+            printf("Failed to create DHT reader lock\n");
+            return -1;
+        }
+    }
+
+    memset(reader, 0, sizeof(*reader));
+    reader->gpio_num = gpio_num;
+    reader->type = type;
+    reader->retries = DHT_READER_DEFAULT_RETRIES;
+    reader->backoff = DHT_READER_DEFAULT_BACKOFF;
+
+    gpio_enable(gpio_num, GPIO_OUT_OPEN_DRAIN);
+    gpio_write(gpio_num, 1);
+
+    return 0;
+}
+
+bool dht_reader_read(dht_reader_t *reader, float *humidity, float *temperature) {
+    uint32_t start = time_ms();
+    uint32_t backoff = reader->backoff;
+    uint8_t data[5];
+    bool ok = false;
+
+    for (int attempt = 0; attempt <= reader->retries; attempt++) {
+        if (attempt) {
+            // Sensor needs time to recover before it can be read again
+            reader->stats.retries++;
+            vTaskDelay(pdMS_TO_TICKS(backoff));
+            backoff *= 2;
+        }
+
+        xSemaphoreTake(capture.lock, portMAX_DELAY);
+        dht_reader_result_t result = dht_reader_capture(reader, data);
+        xSemaphoreGive(capture.lock);
+
+        if (result == dht_reader_ok) {
+            ok = true;
+            break;
+        }
+
+        if (result == dht_reader_timeout)
+            reader->stats.timeouts++;
+        else
+            reader->stats.checksum_errors++;
+    }
+
+    uint32_t latency = time_ms() - start;
+    reader->stats.latency_ms = latency;
+    if (latency > reader->stats.max_latency_ms)
+        reader->stats.max_latency_ms = latency;
+
+    if (!ok) {
+        reader->stats.failures++;
+        return false;
+    }
+
+    reader->stats.reads++;
+    dht_reader_decode(reader, data, humidity, temperature);
+
+    return true;
+}
+
+void dht_reader_get_stats(dht_reader_t *reader, dht_reader_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = reader->stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,15 @@
+# Component makefile for health_metrics
+
+INC_DIRS += $(health_metrics_ROOT)/include
+
+health_metrics_SRC_DIR = $(health_metrics_ROOT)/src
+
+# Per task stack high water marks need uxTaskGetSystemState(), task CPU
+# share also needs run time stats. Set HEALTH_METRICS_TASKS=0 to build
+# FreeRTOS without them.
+HEALTH_METRICS_TASKS ?= 1
+ifeq ($(HEALTH_METRICS_TASKS),1)
+EXTRA_CFLAGS += -DconfigUSE_TRACE_FACILITY=1 -DconfigGENERATE_RUN_TIME_STATS=1
+endif
+
+$(eval $(call component_compile_rules,health_metrics))
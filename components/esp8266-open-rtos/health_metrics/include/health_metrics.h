@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <homekit/types.h>
+
+// Runtime health metrics: free heap (current and lowest seen), stack
+// headroom and CPU share of every task, WiFi reconnects and event
+// counters. Sampled by a task every sample_period ms, printed to UART
+// every report_period ms (0 disables printing) and exposed as read only
+// characteristics of health_metrics_service, which can be added to an
+// accessory's services.
+
+typedef enum {
+    health_metrics_notifications,
+    health_metrics_setter_calls,
+    health_metrics_counter_count,
+} health_metrics_counter_t;
+
+typedef struct {
+    uint32_t uptime;                // seconds
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t min_stack_free;        // smallest stack headroom of all tasks, in words,
+                                    // 0 if built with HEALTH_METRICS_TASKS=0
+    uint32_t reconnects;
+    uint32_t counters[health_metrics_counter_count];
+} health_metrics_stats_t;
+
+extern homekit_service_t health_metrics_service;
+
+int health_metrics_init(uint32_t sample_period, uint32_t report_period);
+
+// Safe to call from any task
+void health_metrics_count(health_metrics_counter_t counter);
+
+// Counts notifications of every notifying characteristic of accessories,
+// both the ones sent with homekit_characteristic_notify() and the ones the
+// server sends after a write. Call once, after the accessories are built.
+void health_metrics_watch(homekit_accessory_t **accessories);
+
+void health_metrics_get_stats(health_metrics_stats_t *stats);
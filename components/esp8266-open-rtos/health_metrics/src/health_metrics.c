@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <espressif/esp_sta.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <homekit/homekit.h>
+#include <homekit/characteristics.h>
+
+#include <health_metrics.h>
+
+#define HEALTH_METRICS_TASK_STACK 384
+#define HEALTH_METRICS_TASK_PRIORITY 1
+
+// Size of the task list buffer; with more tasks than this the per task
+// stats are not updated
+#ifndef HEALTH_METRICS_MAX_TASKS
+#define HEALTH_METRICS_MAX_TASKS 16
+#endif
+
+#define HEALTH_METRICS_UUID(n) "48454C54-0000-1000-8000-0000000000" n
+
+#define HEALTH_METRICS_CHARACTERISTIC(_n, _description) { \
+    .type = HEALTH_METRICS_UUID(_n), \
+    .description = _description, \
+    .format = homekit_format_uint32, \
+    .permissions = homekit_permissions_paired_read, \
+    .value = HOMEKIT_UINT32_(0), \
+}
+
+static homekit_characteristic_t health_metrics_uptime = HEALTH_METRICS_CHARACTERISTIC("01", "Uptime");
+static homekit_characteristic_t health_metrics_free_heap = HEALTH_METRICS_CHARACTERISTIC("02", "Free heap");
+static homekit_characteristic_t health_metrics_min_free_heap = HEALTH_METRICS_CHARACTERISTIC("03", "Min free heap");
+static homekit_characteristic_t health_metrics_min_stack_free = HEALTH_METRICS_CHARACTERISTIC("04", "Min stack free");
+static homekit_characteristic_t health_metrics_reconnects = HEALTH_METRICS_CHARACTERISTIC("05", "Reconnects");
+static homekit_characteristic_t health_metrics_notifications_ch = HEALTH_METRICS_CHARACTERISTIC("06", "Notifications");
+static homekit_characteristic_t health_metrics_setter_calls_ch = HEALTH_METRICS_CHARACTERISTIC("07", "Setter calls");
+
+homekit_service_t health_metrics_service = {
+    .type = HEALTH_METRICS_UUID("00"),
+    .characteristics = (homekit_characteristic_t*[]) {
+        HOMEKIT_CHARACTERISTIC(NAME, "Health"),
+        &health_metrics_uptime,
+        &health_metrics_free_heap,
+        &health_metrics_min_free_heap,
+        &health_metrics_min_stack_free,
+        &health_metrics_reconnects,
+        &health_metrics_notifications_ch,
+        &health_metrics_setter_calls_ch,
+        NULL
+    },
+};
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} health_metrics_task_time_t;
+
+typedef struct {
+    uint32_t sample_period;
+    uint32_t report_period;
+
+    TaskHandle_t task;
+    bool connected;
+    bool connected_once;
+
+    health_metrics_stats_t stats;
+
+#if configUSE_TRACE_FACILITY
+    TaskStatus_t tasks[HEALTH_METRICS_MAX_TASKS];
+#endif
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    uint32_t total_run_time;
+    health_metrics_task_time_t task_times[HEALTH_METRICS_MAX_TASKS];
+#endif
+} health_metrics_t;
+
+static health_metrics_t metrics;
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+#if configUSE_TRACE_FACILITY
+
+static TaskStatus_t *health_metrics_tasks(UBaseType_t *count, uint32_t *total_run_time) {
+    // Sampled periodically, so use a static buffer rather than churn the heap
+    *count = uxTaskGetSystemState(metrics.tasks, HEALTH_METRICS_MAX_TASKS, total_run_time);
+    if (!*count)
+        return NULL;
+
+    return metrics.tasks;
+}
+
+#if configGENERATE_RUN_TIME_STATS
+
+static uint32_t health_metrics_cpu_share(TaskStatus_t *task, uint32_t total_time) {
+    health_metrics_task_time_t *slot = NULL;
+    for (int i = 0; i < HEALTH_METRICS_MAX_TASKS; i++) {
+        health_metrics_task_time_t *t = &metrics.task_times[i];
+        if (t->handle == task->xHandle) {
+            slot = t;
+            break;
+        }
+        if (!slot && !t->handle)
+            slot = t;
+    }
+    if (!slot)
+        return 0;
+
+    uint32_t run_time = task->ulRunTimeCounter - (slot->handle == task->xHandle ? slot->run_time : 0);
+    slot->handle = task->xHandle;
+    slot->run_time = task->ulRunTimeCounter;
+
+    if (!total_time)
+        return 0;
+
+    return (uint64_t)run_time * 100 / total_time;
+}
+
+#endif
+
+static void health_metrics_report_tasks() {
+    UBaseType_t count;
+    uint32_t total_run_time;
+    TaskStatus_t *tasks = health_metrics_tasks(&count, &total_run_time);
+    if (!tasks) {
+        printf("Health: more than %d tasks, not listed\n", HEALTH_METRICS_MAX_TASKS);
+        return;
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t total_time = total_run_time - metrics.total_run_time;
+    metrics.total_run_time = total_run_time;
+
+    // Forget tasks that were deleted
+    for (int i = 0; i < HEALTH_METRICS_MAX_TASKS; i++) {
+        health_metrics_task_time_t *t = &metrics.task_times[i];
+        bool found = false;
+        for (UBaseType_t j = 0; j < count; j++) {
+            if (tasks[j].xHandle == t->handle) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            t->handle = NULL;
+    }
+#endif
+
+    for (UBaseType_t i = 0; i < count; i++) {
+#if configGENERATE_RUN_TIME_STATS
+        printf("Health:   %-16s stack %4u words free, cpu %3u%%\n",
+               tasks[i].pcTaskName, tasks[i].usStackHighWaterMark,
+               health_metrics_cpu_share(&tasks[i], total_time));
+#else
+        printf("Health:   %-16s stack %4u words free\n",
+               tasks[i].pcTaskName, tasks[i].usStackHighWaterMark);
+#endif
+    }
+}
+
+static uint32_t health_metrics_min_stack() {
+    UBaseType_t count;
+    uint32_t total_run_time;
+    TaskStatus_t *tasks = health_metrics_tasks(&count, &total_run_time);
+    if (!tasks)
+        return metrics.stats.min_stack_free;
+
+    uint32_t min_stack = UINT32_MAX;
+    for (UBaseType_t i = 0; i < count; i++) {
+        if (tasks[i].usStackHighWaterMark < min_stack)
+            min_stack = tasks[i].usStackHighWaterMark;
+    }
+
+    return min_stack;
+}
+
+#else
+
+static void health_metrics_report_tasks() {
+}
+
+static uint32_t health_metrics_min_stack() {
+    return 0;
+}
+
+#endif
+
+static void health_metrics_sample() {
+    health_metrics_stats_t *stats = &metrics.stats;
+
+    stats->uptime = time_ms() / 1000;
+
+    // Heap minimum is only as good as the sampling rate
+    stats->free_heap = xPortGetFreeHeapSize();
+    if (!stats->min_free_heap || stats->free_heap < stats->min_free_heap)
+        stats->min_free_heap = stats->free_heap;
+
+    stats->min_stack_free = health_metrics_min_stack();
+
+    bool connected = sdk_wifi_station_get_connect_status() == STATION_GOT_IP;
+    if (connected && !metrics.connected) {
+        // First connection after boot is not a reconnect
+        if (metrics.connected_once)
+            stats->reconnects++;
+        metrics.connected_once = true;
+    }
+    metrics.connected = connected;
+
+    health_metrics_uptime.value.int_value = stats->uptime;
+    health_metrics_free_heap.value.int_value = stats->free_heap;
+    health_metrics_min_free_heap.value.int_value = stats->min_free_heap;
+    health_metrics_min_stack_free.value.int_value = stats->min_stack_free;
+    health_metrics_reconnects.value.int_value = stats->reconnects;
+    health_metrics_notifications_ch.value.int_value = stats->counters[health_metrics_notifications];
+    health_metrics_setter_calls_ch.value.int_value = stats->counters[health_metrics_setter_calls];
+}
+
+static void health_metrics_report() {
+    health_metrics_stats_t *stats = &metrics.stats;
+
+    char min_stack[24];
+#if configUSE_TRACE_FACILITY
+    snprintf(min_stack, sizeof(min_stack), "%u words", stats->min_stack_free);
+#else
+    snprintf(min_stack, sizeof(min_stack), "not available");
+#endif
+
+    printf("Health: uptime %us, heap %u free (min %u), min stack %s, "
+           "%u reconnects, %u notifications, %u setter calls\n",
+           stats->uptime, stats->free_heap, stats->min_free_heap, min_stack,
+           stats->reconnects, stats->counters[health_metrics_notifications],
+           stats->counters[health_metrics_setter_calls]);
+
+    health_metrics_report_tasks();
+}
+
+static void health_metrics_task(void *_args) {
+    uint32_t last_report = time_ms();
+
+    while (true) {
+        health_metrics_sample();
+
+        uint32_t now = time_ms();
+        if (metrics.report_period && now - last_report >= metrics.report_period) {
+            health_metrics_report();
+            last_report = now;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(metrics.sample_period));
+    }
+}
+
+int health_metrics_init(uint32_t sample_period, uint32_t report_period) {
+    if (metrics.task)
+        return 0;
+
+    metrics.sample_period = sample_period ? sample_period : 1000;
+    metrics.report_period = report_period;
+
+    if (xTaskCreate(health_metrics_task, "Health", HEALTH_METRICS_TASK_STACK, NULL,
+                    HEALTH_METRICS_TASK_PRIORITY, &metrics.task) != pdPASS) {
+        printf("Failed to create health metrics task\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void health_metrics_count(health_metrics_counter_t counter) {
+    taskENTER_CRITICAL();
+    metrics.stats.counters[counter]++;
+    taskEXIT_CRITICAL();
+}
+
+void health_metrics_get_stats(health_metrics_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = metrics.stats;
+    taskEXIT_CRITICAL();
+}
+
+static void health_metrics_on_notify(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    health_metrics_count(health_metrics_notifications);
+}
+
+void health_metrics_watch(homekit_accessory_t **accessories) {
+    for (homekit_accessory_t **accessory = accessories; *accessory; accessory++) {
+        for (homekit_service_t **service = (*accessory)->services; *service; service++) {
+            for (homekit_characteristic_t **ch = (*service)->characteristics; *ch; ch++) {
+                if ((*ch)->permissions & homekit_permissions_notify)
+                    homekit_characteristic_add_notify_callback(*ch, health_metrics_on_notify, NULL);
+            }
+        }
+    }
+}
@@ -0,0 +1,27 @@
+# Component makefile for homekit_rom
+#
+# Keeps read only data of static accessory definitions in flash.
+#
+# On esp-open-rtos .rodata is linked into DRAM, so every type UUID,
+# description and constant string (MANUFACTURER, MODEL, ...) expanded from
+# HOMEKIT_ACCESSORY/HOMEKIT_SERVICE/HOMEKIT_CHARACTERISTIC definitions takes
+# heap away. Sources listed in HOMEKIT_ROM_SRCS are compiled through
+# rom-cc, which renames the object's .rodata* sections to .irom0.literal.*
+# so the linker places them in flash next to IROM variables, and reports
+# how many bytes were moved. Byte and halfword reads from flash are handled
+# by the core load/store exception handler, so the code doesn't change.
+#
+# Characteristic structs themselves stay in RAM, they hold values and
+# callback state that change at runtime.
+#
+# Don't list sources with code that runs while flash cache is disabled
+# (IRAM interrupt handlers, flash writes).
+#
+# Usage, in program Makefile:
+#   HOMEKIT_ROM_SRCS = thermostat.c
+
+HOMEKIT_ROM ?= 1
+
+ifeq ($(HOMEKIT_ROM),1)
+$(foreach src,$(HOMEKIT_ROM_SRCS),$(eval %/$(src:.c=.o): CC := $(homekit_rom_ROOT)/rom-cc $(CC)))
+endif
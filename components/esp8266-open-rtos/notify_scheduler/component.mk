@@ -0,0 +1,7 @@
+# Component makefile for notify_scheduler
+
+INC_DIRS += $(notify_scheduler_ROOT)/include
+
+notify_scheduler_SRC_DIR = $(notify_scheduler_ROOT)/src
+
+$(eval $(call component_compile_rules,notify_scheduler))
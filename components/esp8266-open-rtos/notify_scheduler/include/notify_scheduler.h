@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <homekit/types.h>
+
+// Rate limits homekit_characteristic_notify() for fast changing values.
+//
+// Only the latest submitted value of a registered characteristic is kept.
+// It is sent once min_interval_ms has passed since the previous notification
+// and only if it differs from the last sent value by at least threshold
+// (any difference when threshold is 0). All due values are sent back to back
+// from one task, so the server can put them into a single EVENT message.
+// Only numeric and bool formats are supported, other characteristics and
+// characteristics that were not added are notified right away.
+
+#ifndef NOTIFY_SCHEDULER_MAX
+#define NOTIFY_SCHEDULER_MAX 8
+#endif
+
+typedef struct {
+    uint32_t submitted;             // notify requests
+    uint32_t sent;                  // notifications passed to the server
+    uint32_t suppressed;            // requests below change threshold
+} notify_scheduler_stats_t;
+
+int notify_scheduler_init();
+
+int notify_scheduler_add(homekit_characteristic_t *ch, uint16_t min_interval_ms, float threshold);
+
+// Use instead of homekit_characteristic_notify()
+void notify_scheduler_submit(homekit_characteristic_t *ch, homekit_value_t value);
+
+// Sends all pending values right away (e.g. when a movement stops)
+void notify_scheduler_flush();
+
+void notify_scheduler_get_stats(notify_scheduler_stats_t *stats);
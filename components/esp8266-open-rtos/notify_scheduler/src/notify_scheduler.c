@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <homekit/homekit.h>
+#include <notify_scheduler.h>
+
+#define NOTIFY_SCHEDULER_TASK_STACK 512
+#define NOTIFY_SCHEDULER_TASK_PRIORITY 2
+
+typedef struct {
+    homekit_characteristic_t *ch;
+    TickType_t min_interval;
+    float threshold;
+
+    bool pending;
+    bool sent_once;
+    homekit_value_t value;
+    float sent_value;
+    TickType_t sent_time;
+} notify_entry_t;
+
+typedef struct {
+    TaskHandle_t task;
+    SemaphoreHandle_t lock;
+
+    notify_entry_t entries[NOTIFY_SCHEDULER_MAX];
+    uint8_t count;
+    bool flush;
+
+    notify_scheduler_stats_t stats;
+} notify_scheduler_t;
+
+static notify_scheduler_t scheduler;
+
+
+static bool value_to_number(const homekit_value_t *value, float *number) {
+    if (value->is_null)
+        return false;
+
+    switch (value->format) {
+        case homekit_format_bool:
+            *number = value->bool_value;
+            return true;
+        case homekit_format_uint8:
+        case homekit_format_uint16:
+        case homekit_format_uint32:
+        case homekit_format_int:
+            *number = value->int_value;
+            return true;
+        case homekit_format_float:
+            *number = value->float_value;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static notify_entry_t *notify_scheduler_find(homekit_characteristic_t *ch) {
+    for (int i = 0; i < scheduler.count; i++)
+        if (scheduler.entries[i].ch == ch)
+            return &scheduler.entries[i];
+
+    return NULL;
+}
+
+static void notify_scheduler_task(void *_args) {
+    homekit_characteristic_t *chs[NOTIFY_SCHEDULER_MAX];
+    homekit_value_t values[NOTIFY_SCHEDULER_MAX];
+
+    while (true) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t timeout = portMAX_DELAY;
+        uint8_t due = 0;
+
+        xSemaphoreTake(scheduler.lock, portMAX_DELAY);
+        bool flush = scheduler.flush;
+        scheduler.flush = false;
+        for (int i = 0; i < scheduler.count; i++) {
+            notify_entry_t *entry = &scheduler.entries[i];
+            if (!entry->pending)
+                continue;
+
+            TickType_t elapsed = now - entry->sent_time;
+            if (!flush && entry->sent_once && elapsed < entry->min_interval) {
+                if (entry->min_interval - elapsed < timeout)
+                    timeout = entry->min_interval - elapsed;
+                continue;
+            }
+
+            entry->pending = false;
+            entry->sent_once = true;
+            entry->sent_time = now;
+            value_to_number(&entry->value, &entry->sent_value);
+
+            chs[due] = entry->ch;
+            values[due] = entry->value;
+            due++;
+        }
+        scheduler.stats.sent += due;
+        xSemaphoreGive(scheduler.lock);
+
+        for (int i = 0; i < due; i++)
+            homekit_characteristic_notify(chs[i], values[i]);
+
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+int notify_scheduler_init() {
+    memset(&scheduler, 0, sizeof(scheduler));
+
+    scheduler.lock = xSemaphoreCreateMutex();
+    if (!scheduler.lock) {
+        printf("Failed to create notify scheduler lock\n");
+        return -1;
+    }
+
+    if (xTaskCreate(notify_scheduler_task, "Notify", NOTIFY_SCHEDULER_TASK_STACK, NULL,
+                    NOTIFY_SCHEDULER_TASK_PRIORITY, &scheduler.task) != pdPASS) {
+        printf("Failed to create notify scheduler task\n");
+        vSemaphoreDelete(scheduler.lock);
+        scheduler.lock = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int notify_scheduler_add(homekit_characteristic_t *ch, uint16_t min_interval_ms, float threshold) {
+    xSemaphoreTake(scheduler.lock, portMAX_DELAY);
+
+    notify_entry_t *entry = notify_scheduler_find(ch);
+    if (!entry) {
+        if (scheduler.count >= NOTIFY_SCHEDULER_MAX) {
+            xSemaphoreGive(scheduler.lock);
+            printf("Failed to add notify scheduler entry, too many characteristics\n");
+            return -1;
+        }
+        entry = &scheduler.entries[scheduler.count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->ch = ch;
+    }
+
+    entry->min_interval = pdMS_TO_TICKS(min_interval_ms);
+    entry->threshold = threshold;
+
+    xSemaphoreGive(scheduler.lock);
+
+    return 0;
+}
+
+void notify_scheduler_submit(homekit_characteristic_t *ch, homekit_value_t value) {
+    float number;
+    bool numeric = value_to_number(&value, &number);
+
+    xSemaphoreTake(scheduler.lock, portMAX_DELAY);
+    scheduler.stats.submitted++;
+
+    notify_entry_t *entry = numeric ? notify_scheduler_find(ch) : NULL;
+    if (!entry) {
+        scheduler.stats.sent++;
+        xSemaphoreGive(scheduler.lock);
+        homekit_characteristic_notify(ch, value);
+        return;
+    }
+
+    float delta = number - entry->sent_value;
+    if (delta < 0)
+        delta = -delta;
+    if (entry->sent_once && (delta == 0 || delta < entry->threshold)) {
+        // Controllers already have a close enough value, drop anything pending
+        entry->pending = false;
+        scheduler.stats.suppressed++;
+        xSemaphoreGive(scheduler.lock);
+        return;
+    }
+
+    entry->value = value;
+    bool wake = !entry->pending;
+    entry->pending = true;
+    xSemaphoreGive(scheduler.lock);
+
+    // Only the first pending value needs a wake up, the task has
+    // already scheduled the ones that follow.
+    if (wake)
+        xTaskNotifyGive(scheduler.task);
+}
+
+void notify_scheduler_flush() {
+    xSemaphoreTake(scheduler.lock, portMAX_DELAY);
+    scheduler.flush = true;
+    xSemaphoreGive(scheduler.lock);
+
+    xTaskNotifyGive(scheduler.task);
+}
+
+void notify_scheduler_get_stats(notify_scheduler_stats_t *stats) {
+    xSemaphoreTake(scheduler.lock, portMAX_DELAY);
+    *stats = scheduler.stats;
+    xSemaphoreGive(scheduler.lock);
+}
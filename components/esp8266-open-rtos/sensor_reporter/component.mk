@@ -0,0 +1,7 @@
+# Component makefile for sensor_reporter
+
+INC_DIRS += $(sensor_reporter_ROOT)/include
+
+sensor_reporter_SRC_DIR = $(sensor_reporter_ROOT)/src
+
+$(eval $(call component_compile_rules,sensor_reporter))
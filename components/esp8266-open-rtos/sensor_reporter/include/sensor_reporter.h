@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <homekit/types.h>
+
+// Samples a sensor at one rate and reports to HomeKit at another.
+//
+// Every sample_period the read function is called and each value is run
+// through an exponential moving average and stored in its (float format)
+// characteristic. Every report_period a channel is notified only if its
+// filtered value moved at least deadband from the last notified value, or
+// nothing was notified for heartbeat ms (0 disables the heartbeat).
+
+#ifndef SENSOR_REPORTER_MAX_CHANNELS
+#define SENSOR_REPORTER_MAX_CHANNELS 4
+#endif
+
+// Fills one value per channel, returns false if the sensor couldn't be read
+typedef bool (*sensor_reporter_read_fn)(float *values, void *context);
+
+typedef struct {
+    homekit_characteristic_t *ch;
+    float deadband;
+    float alpha;                    // EMA weight of a new sample, 1 disables filtering
+} sensor_reporter_channel_t;
+
+typedef struct {
+    // times in milliseconds
+    uint32_t sample_period;
+    uint32_t report_period;
+    uint32_t heartbeat;
+
+    sensor_reporter_read_fn read;
+    void *context;
+
+    uint8_t channel_count;
+    sensor_reporter_channel_t channels[SENSOR_REPORTER_MAX_CHANNELS];
+} sensor_reporter_config_t;
+
+typedef struct {
+    uint32_t samples;               // successful reads
+    uint32_t failures;              // failed reads
+    uint32_t notifications;         // values sent to HomeKit
+    uint32_t suppressed;            // reports skipped within deadband
+} sensor_reporter_stats_t;
+
+typedef struct {
+    const sensor_reporter_config_t *config;
+    TaskHandle_t task;
+
+    bool valid;
+    float values[SENSOR_REPORTER_MAX_CHANNELS];
+    float reported[SENSOR_REPORTER_MAX_CHANNELS];
+    uint32_t report_time[SENSOR_REPORTER_MAX_CHANNELS];
+    bool reported_once[SENSOR_REPORTER_MAX_CHANNELS];
+
+    sensor_reporter_stats_t stats;
+} sensor_reporter_t;
+
+// config has to stay valid while the reporter runs
+int sensor_reporter_start(sensor_reporter_t *reporter, const sensor_reporter_config_t *config);
+
+void sensor_reporter_get_stats(sensor_reporter_t *reporter, sensor_reporter_stats_t *stats);
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <homekit/homekit.h>
+#include <sensor_reporter.h>
+
+#define SENSOR_REPORTER_TASK_STACK 512
+#define SENSOR_REPORTER_TASK_PRIORITY 2
+
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void sensor_reporter_sample(sensor_reporter_t *reporter) {
+    const sensor_reporter_config_t *config = reporter->config;
+    float values[SENSOR_REPORTER_MAX_CHANNELS];
+
+    if (!config->read(values, config->context)) {
+        reporter->stats.failures++;
+        return;
+    }
+    reporter->stats.samples++;
+
+    for (int i = 0; i < config->channel_count; i++) {
+        const sensor_reporter_channel_t *channel = &config->channels[i];
+        if (reporter->valid)
+            reporter->values[i] += channel->alpha * (values[i] - reporter->values[i]);
+        else
+            reporter->values[i] = values[i];
+
+        // Reads by controllers always get the latest filtered value
+        channel->ch->value = HOMEKIT_FLOAT(reporter->values[i]);
+    }
+    reporter->valid = true;
+}
+
+static void sensor_reporter_report(sensor_reporter_t *reporter, uint32_t now) {
+    const sensor_reporter_config_t *config = reporter->config;
+
+    if (!reporter->valid)
+        return;
+
+    for (int i = 0; i < config->channel_count; i++) {
+        const sensor_reporter_channel_t *channel = &config->channels[i];
+
+        float delta = reporter->values[i] - reporter->reported[i];
+        if (delta < 0)
+            delta = -delta;
+
+        bool silent = config->heartbeat && now - reporter->report_time[i] >= config->heartbeat;
+        if (reporter->reported_once[i] && delta < channel->deadband && !silent) {
+            reporter->stats.suppressed++;
+            continue;
+        }
+
+        reporter->reported[i] = reporter->values[i];
+        reporter->report_time[i] = now;
+        reporter->reported_once[i] = true;
+        reporter->stats.notifications++;
+
+        homekit_characteristic_notify(channel->ch, HOMEKIT_FLOAT(reporter->values[i]));
+    }
+}
+
+static void sensor_reporter_task(void *_args) {
+    sensor_reporter_t *reporter = _args;
+    const sensor_reporter_config_t *config = reporter->config;
+
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t next_report = time_ms();
+
+    while (true) {
+        sensor_reporter_sample(reporter);
+
+        uint32_t now = time_ms();
+        if ((int32_t)(now - next_report) >= 0) {
+            sensor_reporter_report(reporter, now);
+            next_report = now + config->report_period;
+        }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(config->sample_period));
+    }
+}
+
+int sensor_reporter_start(sensor_reporter_t *reporter, const sensor_reporter_config_t *config) {
+    if (config->channel_count > SENSOR_REPORTER_MAX_CHANNELS || !config->read) {
+        printf("Failed to start sensor reporter, invalid config\n");
+        return -1;
+    }
+
+    memset(reporter, 0, sizeof(*reporter));
+    reporter->config = config;
+
+    if (xTaskCreate(sensor_reporter_task, "Sensor reporter", SENSOR_REPORTER_TASK_STACK, reporter,
+                    SENSOR_REPORTER_TASK_PRIORITY, &reporter->task) != pdPASS) {
+        printf("Failed to create sensor reporter task\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void sensor_reporter_get_stats(sensor_reporter_t *reporter, sensor_reporter_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = reporter->stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,7 @@
+# Component makefile for thermostat_control
+
+INC_DIRS += $(thermostat_control_ROOT)/include
+
+thermostat_control_SRC_DIR = $(thermostat_control_ROOT)/src
+
+$(eval $(call component_compile_rules,thermostat_control))
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Platform independent thermostat control: sensor filtering, hysteresis
+// or time proportioning PID control and compressor protection. All times
+// are in milliseconds and passed in by the caller, temperatures in Celsius.
+
+#ifndef THERMOSTAT_FILTER_SIZE
+#define THERMOSTAT_FILTER_SIZE 5
+#endif
+
+// Same values as HomeKit TARGET_HEATING_COOLING_STATE
+typedef enum {
+    thermostat_mode_off = 0,
+    thermostat_mode_heat = 1,
+    thermostat_mode_cool = 2,
+    thermostat_mode_auto = 3,
+} thermostat_mode_t;
+
+// Same values as HomeKit CURRENT_HEATING_COOLING_STATE
+typedef enum {
+    thermostat_output_off = 0,
+    thermostat_output_heat = 1,
+    thermostat_output_cool = 2,
+} thermostat_output_t;
+
+// Median of the last THERMOSTAT_FILTER_SIZE samples (drops single bad
+// readings) smoothed by an exponential moving average.
+typedef struct {
+    float samples[THERMOSTAT_FILTER_SIZE];
+    uint8_t count;
+    uint8_t index;
+
+    float alpha;                    // EMA weight of a new value, 0 < alpha <= 1
+    float value;
+} thermostat_filter_t;
+
+void thermostat_filter_init(thermostat_filter_t *filter, float alpha);
+
+// Adds a sample and returns the filtered value
+float thermostat_filter_add(thermostat_filter_t *filter, float sample);
+
+typedef struct {
+    // Width of the band around a setpoint in which the output doesn't change
+    float hysteresis;
+
+    // Compressor protection
+    uint32_t min_on_time;
+    uint32_t min_off_time;
+
+    // Time proportioning PID for heat and cool modes, used if cycle_time > 0.
+    // Output is on for duty * cycle_time at the start of every cycle.
+    float kp;                       // duty per degree
+    float ki;                       // duty per degree and second
+    float kd;                       // duty per degree per second
+    uint32_t cycle_time;
+} thermostat_control_config_t;
+
+typedef struct {
+    const thermostat_control_config_t *config;
+
+    thermostat_output_t output;
+    uint32_t output_time;           // when output last changed
+    bool output_changed;            // output changed at least once
+
+    thermostat_mode_t pid_mode;
+    float integral;
+    float last_error;
+    uint32_t last_time;
+    uint32_t cycle_start;
+    float duty;
+
+    uint32_t cycles;                // number of times output was switched on
+} thermostat_control_t;
+
+void thermostat_control_init(thermostat_control_t *control, const thermostat_control_config_t *config);
+
+// Returns the output to apply. Call on every new (filtered) temperature and
+// at least every few seconds when time proportioning is used.
+// target is used in heat and cool modes, the thresholds in auto mode.
+thermostat_output_t thermostat_control_update(thermostat_control_t *control, thermostat_mode_t mode,
+                                              float temperature, float target,
+                                              float heating_threshold, float cooling_threshold,
+                                              uint32_t now);
@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include <thermostat_control.h>
+
+
+void thermostat_filter_init(thermostat_filter_t *filter, float alpha) {
+    memset(filter, 0, sizeof(*filter));
+    filter->alpha = (alpha > 0 && alpha <= 1) ? alpha : 1;
+}
+
+float thermostat_filter_add(thermostat_filter_t *filter, float sample) {
+    filter->samples[filter->index] = sample;
+    filter->index = (filter->index + 1) % THERMOSTAT_FILTER_SIZE;
+    if (filter->count < THERMOSTAT_FILTER_SIZE)
+        filter->count++;
+
+    // Insertion sort of a handful of samples
+    float sorted[THERMOSTAT_FILTER_SIZE];
+    for (int i = 0; i < filter->count; i++) {
+        float value = filter->samples[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    float median = sorted[filter->count / 2];
+
+    if (filter->count == 1)
+        filter->value = median;
+    else
+        filter->value += filter->alpha * (median - filter->value);
+
+    return filter->value;
+}
+
+
+void thermostat_control_init(thermostat_control_t *control, const thermostat_control_config_t *config) {
+    memset(control, 0, sizeof(*control));
+    control->config = config;
+}
+
+// Hysteresis: switch on below setpoint - band/2, off above setpoint + band/2
+// (mirrored for cooling), keep current output in between.
+static bool thermostat_band(bool on, float error, float hysteresis) {
+    if (error > hysteresis / 2)
+        return true;
+    if (error < -hysteresis / 2)
+        return false;
+    return on;
+}
+
+static bool thermostat_pid(thermostat_control_t *control, thermostat_mode_t mode, float error, uint32_t now) {
+    const thermostat_control_config_t *config = control->config;
+
+    if (control->pid_mode != mode) {
+        control->pid_mode = mode;
+        control->integral = 0;
+        control->last_error = error;
+        control->last_time = now;
+        control->cycle_start = now - config->cycle_time;
+    }
+
+    float dt = (now - control->last_time) / 1000.0f;
+    float derivative = dt > 0 ? (error - control->last_error) / dt : 0;
+    control->last_error = error;
+    control->last_time = now;
+
+    // Duty is fixed for a whole cycle
+    if (now - control->cycle_start >= config->cycle_time) {
+        control->cycle_start = now;
+
+        float duty = config->kp * error + config->ki * control->integral + config->kd * derivative;
+        // Integrate only while not saturated (anti windup)
+        if ((duty < 1 || error < 0) && (duty > 0 || error > 0))
+            control->integral += error * config->cycle_time / 1000.0f;
+
+        control->duty = duty < 0 ? 0 : duty > 1 ? 1 : duty;
+    }
+
+    return (now - control->cycle_start) < control->duty * config->cycle_time;
+}
+
+thermostat_output_t thermostat_control_update(thermostat_control_t *control, thermostat_mode_t mode,
+                                              float temperature, float target,
+                                              float heating_threshold, float cooling_threshold,
+                                              uint32_t now) {
+    const thermostat_control_config_t *config = control->config;
+    thermostat_output_t output = control->output;
+    thermostat_output_t wanted = thermostat_output_off;
+
+    bool heating = output == thermostat_output_heat;
+    bool cooling = output == thermostat_output_cool;
+    bool pid = config->cycle_time > 0;
+
+    switch (mode) {
+        case thermostat_mode_heat:
+            if (pid ? thermostat_pid(control, mode, target - temperature, now)
+                    : thermostat_band(heating, target - temperature, config->hysteresis))
+                wanted = thermostat_output_heat;
+            break;
+        case thermostat_mode_cool:
+            if (pid ? thermostat_pid(control, mode, temperature - target, now)
+                    : thermostat_band(cooling, temperature - target, config->hysteresis))
+                wanted = thermostat_output_cool;
+            break;
+        case thermostat_mode_auto:
+            if (thermostat_band(heating, heating_threshold - temperature, config->hysteresis))
+                wanted = thermostat_output_heat;
+            else if (thermostat_band(cooling, temperature - cooling_threshold, config->hysteresis))
+                wanted = thermostat_output_cool;
+            break;
+        default:
+            break;
+    }
+    if (!pid || mode == thermostat_mode_auto || mode == thermostat_mode_off)
+        control->pid_mode = thermostat_mode_off;
+
+    if (wanted == output)
+        return output;
+
+    // Switching between heating and cooling always goes through off
+    if (output != thermostat_output_off && wanted != thermostat_output_off)
+        wanted = thermostat_output_off;
+
+    if (control->output_changed) {
+        uint32_t elapsed = now - control->output_time;
+        if (output != thermostat_output_off && elapsed < config->min_on_time)
+            return output;
+        if (output == thermostat_output_off && elapsed < config->min_off_time)
+            return output;
+    }
+
+    control->output = wanted;
+    control->output_time = now;
+    control->output_changed = true;
+    if (wanted != thermostat_output_off)
+        control->cycles++;
+
+    return wanted;
+}
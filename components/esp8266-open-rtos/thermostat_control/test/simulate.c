@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <thermostat_control.h>
+
+// Thermal plant simulation for thermostat_control.
+//
+// The room is a first order model: it loses heat to the outside with time
+// constant ROOM_TAU and the heater adds HEATER_RATE degrees per hour. The
+// sensor is a DHT11: whole degrees, gaussian noise and an occasional wild
+// reading, sampled every SAMPLE_PERIOD like examples/thermostat. Each
+// controller runs for SIMULATION_TIME in heat mode and reports how often
+// the relay switched on and how far the true room temperature was from the
+// target after the warm up.
+
+#define SIMULATION_TIME (24 * 3600)     // seconds
+#define WARM_UP (3600)                  // excluded from the error
+#define SAMPLE_PERIOD 10                // seconds, TEMPERATURE_POLL_PERIOD of the example
+
+#define TARGET 21.0f
+#define OUTSIDE 5.0f
+#define START 15.0f
+#define ROOM_TAU (4 * 3600.0f)          // seconds
+#define HEATER_RATE 8.0f                // degrees per hour while heating
+
+#define SENSOR_NOISE 0.3f               // standard deviation before quantization
+#define SENSOR_GLITCH_RATE 200          // one wild reading in this many
+
+static uint32_t rng_state;
+
+static uint32_t rng() {
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+static float gaussian() {
+    // Irwin-Hall approximation, good enough for sensor noise
+    float sum = 0;
+    for (int i = 0; i < 12; i++)
+        sum += (rng() & 0xffff) / 65536.0f;
+    return sum - 6;
+}
+
+static float sensor_read(float temperature) {
+    if (rng() % SENSOR_GLITCH_RATE == 0)
+        return temperature + ((rng() & 1) ? 10 : -10);
+    return roundf(temperature + SENSOR_NOISE * gaussian());
+}
+
+typedef struct {
+    const char *name;
+    const thermostat_control_config_t *config;  // NULL for the old raw comparator
+    float filter_alpha;
+} controller_t;
+
+typedef struct {
+    uint32_t cycles;
+    float mean_error;
+    float max_error;
+} result_t;
+
+static result_t simulate(const controller_t *controller) {
+    thermostat_control_t control;
+    thermostat_filter_t filter;
+    if (controller->config)
+        thermostat_control_init(&control, controller->config);
+    thermostat_filter_init(&filter, controller->filter_alpha);
+
+    rng_state = 12345;
+
+    float room = START;
+    bool heating = false;
+    double error_sum = 0;
+    uint32_t error_count = 0;
+    result_t result = { 0 };
+
+    for (uint32_t t = 0; t < SIMULATION_TIME; t++) {
+        if (t % SAMPLE_PERIOD == 0) {
+            float reading = sensor_read(room);
+            bool on;
+            if (controller->config) {
+                float temperature = thermostat_filter_add(&filter, reading);
+                on = thermostat_control_update(&control, thermostat_mode_heat, temperature, TARGET,
+                                               0, 0, t * 1000) == thermostat_output_heat;
+            } else {
+                // update_state() before thermostat_control
+                on = reading < TARGET;
+            }
+
+            if (on && !heating)
+                result.cycles++;
+            heating = on;
+        }
+
+        room += (OUTSIDE - room) / ROOM_TAU + (heating ? HEATER_RATE / 3600 : 0);
+
+        if (t >= WARM_UP) {
+            float error = fabsf(room - TARGET);
+            error_sum += error;
+            error_count++;
+            if (error > result.max_error)
+                result.max_error = error;
+        }
+    }
+
+    result.mean_error = error_sum / error_count;
+    return result;
+}
+
+// Settings of examples/thermostat
+static const thermostat_control_config_t hysteresis_config = {
+    .hysteresis = 1.0,
+    .min_on_time = 180000,
+    .min_off_time = 180000,
+};
+
+static const thermostat_control_config_t pid_config = {
+    .min_on_time = 180000,
+    .min_off_time = 180000,
+    .kp = 0.5,
+    .ki = 0.0002,
+    .kd = 0,
+    .cycle_time = 900000,
+};
+
+static const controller_t controllers[] = {
+    { "raw comparator", NULL, 1 },
+    { "filter + hysteresis", &hysteresis_config, 0.3 },
+    { "filter + PID 15 min", &pid_config, 0.3 },
+};
+
+int main() {
+    printf("Heating %.0f -> %.0f C, outside %.0f C, %u h\n",
+           START, TARGET, OUTSIDE, SIMULATION_TIME / 3600);
+    printf("%-22s %8s %12s %12s\n", "controller", "cycles", "mean error", "max error");
+
+    for (size_t i = 0; i < sizeof(controllers) / sizeof(*controllers); i++) {
+        result_t result = simulate(&controllers[i]);
+        printf("%-22s %8u %10.2f C %10.2f C\n",
+               controllers[i].name, result.cycles, result.mean_error, result.max_error);
+    }
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+# Component makefile for wifi_manager
+
+INC_DIRS += $(wifi_manager_ROOT)/include
+
+wifi_manager_SRC_DIR = $(wifi_manager_ROOT)/src
+
+$(eval $(call component_compile_rules,wifi_manager))
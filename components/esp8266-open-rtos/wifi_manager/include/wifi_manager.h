@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Station connection manager with fast reconnect.
+//
+// BSSID and channel of the access point (and the DHCP lease) are cached in
+// sysparam flash. On boot the cached access point is joined directly,
+// without a full channel scan, which falls back to a normal connect if it
+// doesn't work out within a few seconds. Failed connects are retried with
+// a doubling back off. on_ready is called exactly once, the first time the
+// station gets an IP address, from the manager task.
+
+typedef enum {
+    wifi_manager_event_associated,
+    wifi_manager_event_got_ip,
+    wifi_manager_event_disconnected,
+} wifi_manager_event_t;
+
+typedef void (*wifi_manager_ready_fn)();
+typedef void (*wifi_manager_event_fn)(wifi_manager_event_t event);
+
+typedef struct {
+    const char *ssid;
+    const char *password;
+
+    // Optional static address, e.g. "192.168.1.50" (NULL to use DHCP)
+    const char *ip;
+    const char *netmask;
+    const char *gateway;
+
+    // Reuse the cached DHCP lease as static address to skip DHCP on boot.
+    // Saves about a second, but the address should be reserved for this
+    // device on the router.
+    bool reuse_lease;
+
+    wifi_manager_ready_fn on_ready;
+
+    // Optional, called on every station event from the SDK event handler,
+    // must not block
+    wifi_manager_event_fn on_event;
+} wifi_manager_config_t;
+
+typedef struct {
+    uint32_t connect_time;          // ms from start to first IP address
+    bool fast_connect;              // first connection used the cache
+    uint32_t attempts;              // failed connect attempts
+    uint32_t reconnects;            // connection lost after being ready
+} wifi_manager_stats_t;
+
+// config is copied, strings are not
+int wifi_manager_start(const wifi_manager_config_t *config);
+
+void wifi_manager_get_stats(wifi_manager_stats_t *stats);
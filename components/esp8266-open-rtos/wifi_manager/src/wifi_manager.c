@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <espressif/esp_wifi.h>
+#include <espressif/esp_sta.h>
+#include <lwip/ip_addr.h>
+#include <sysparam.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <wifi_manager.h>
+
+#define WIFI_MANAGER_TASK_STACK 384
+#define WIFI_MANAGER_TASK_PRIORITY 2
+
+#define WIFI_MANAGER_CACHE_KEY "wifi_manager"
+
+// times in milliseconds
+#define WIFI_MANAGER_POLL_PERIOD 50
+#define WIFI_MANAGER_FAST_TIMEOUT 3000      // fast connect falls back to a scan after this
+#define WIFI_MANAGER_CONNECT_TIMEOUT 15000
+#define WIFI_MANAGER_BACKOFF_MIN 1000
+#define WIFI_MANAGER_BACKOFF_MAX 60000
+
+typedef struct {
+    char ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gateway;
+} wifi_manager_cache_t;
+
+typedef enum {
+    wifi_manager_state_connecting,
+    wifi_manager_state_connected,
+    wifi_manager_state_waiting,
+} wifi_manager_state_t;
+
+typedef struct {
+    wifi_manager_config_t config;
+    TaskHandle_t task;
+
+    wifi_manager_cache_t cache;
+    bool cache_valid;
+
+    // Access point of the current connection, set from the event handler
+    uint8_t bssid[6];
+    uint8_t channel;
+
+    wifi_manager_state_t state;
+    bool fast;                      // current attempt uses cached access point
+    bool cached_ip;                 // current attempt uses cached lease
+    bool ready;
+    uint32_t start_time;
+    uint32_t attempt_time;
+    uint32_t backoff;
+
+    wifi_manager_stats_t stats;
+} wifi_manager_t;
+
+static wifi_manager_t manager;
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void wifi_manager_event(sdk_System_Event_t *event) {
+    wifi_manager_event_t manager_event;
+    switch (event->event_id) {
+        case EVENT_STAMODE_CONNECTED:
+            memcpy(manager.bssid, event->event_info.connected.bssid, sizeof(manager.bssid));
+            manager.channel = event->event_info.connected.channel;
+            manager_event = wifi_manager_event_associated;
+            break;
+        case EVENT_STAMODE_GOT_IP:
+            manager_event = wifi_manager_event_got_ip;
+            break;
+        case EVENT_STAMODE_DISCONNECTED:
+            manager_event = wifi_manager_event_disconnected;
+            break;
+        default:
+            return;
+    }
+
+    if (manager.config.on_event)
+        manager.config.on_event(manager_event);
+
+    if (manager.task)
+        xTaskNotifyGive(manager.task);
+}
+
+static void wifi_manager_load_cache() {
+    size_t length = 0;
+    bool is_binary;
+    if (sysparam_get_data_static(WIFI_MANAGER_CACHE_KEY, (uint8_t*)&manager.cache, sizeof(manager.cache),
+                                 &length, &is_binary) != SYSPARAM_OK ||
+            length != sizeof(manager.cache)) {
+        return;
+    }
+
+    // Cache of another network is useless
+    manager.cache_valid = !strncmp(manager.cache.ssid, manager.config.ssid, sizeof(manager.cache.ssid)) &&
+                          manager.cache.channel;
+}
+
+static void wifi_manager_save_cache() {
+    static const uint8_t no_bssid[6] = { 0 };
+    if (!memcmp(manager.bssid, no_bssid, sizeof(no_bssid))) {
+        // Didn't see the connect event, nothing useful to cache
+        return;
+    }
+
+    wifi_manager_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    strncpy(cache.ssid, manager.config.ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, manager.bssid, sizeof(cache.bssid));
+    cache.channel = manager.channel ? manager.channel : sdk_wifi_get_channel();
+
+    if (manager.cached_ip || manager.config.ip) {
+        // Keep the last lease we actually got from DHCP
+        cache.ip = manager.cache.ip;
+        cache.netmask = manager.cache.netmask;
+        cache.gateway = manager.cache.gateway;
+    } else {
+        struct ip_info info;
+        sdk_wifi_get_ip_info(STATION_IF, &info);
+        cache.ip = info.ip.addr;
+        cache.netmask = info.netmask.addr;
+        cache.gateway = info.gw.addr;
+    }
+
+    // Flash is only written when something changed
+    if (manager.cache_valid && !memcmp(&cache, &manager.cache, sizeof(cache)))
+        return;
+
+    if (sysparam_set_data(WIFI_MANAGER_CACHE_KEY, (uint8_t*)&cache, sizeof(cache), true) != SYSPARAM_OK) {
+        printf("Failed to save WiFi cache\n");
+        return;
+    }
+
+    manager.cache = cache;
+    manager.cache_valid = true;
+}
+
+static void wifi_manager_set_ip(uint32_t ip, uint32_t netmask, uint32_t gateway) {
+    struct ip_info info;
+    memset(&info, 0, sizeof(info));
+    info.ip.addr = ip;
+    info.netmask.addr = netmask;
+    info.gw.addr = gateway;
+
+    sdk_wifi_station_dhcpc_stop();
+    sdk_wifi_set_ip_info(STATION_IF, &info);
+}
+
+static void wifi_manager_connect(bool fast) {
+    struct sdk_station_config config;
+    memset(&config, 0, sizeof(config));
+    strncpy((char*)config.ssid, manager.config.ssid, sizeof(config.ssid));
+    strncpy((char*)config.password, manager.config.password, sizeof(config.password));
+
+    manager.fast = fast && manager.cache_valid;
+    if (manager.fast) {
+        // Join the known access point directly instead of scanning all channels
+        config.bssid_set = 1;
+        memcpy(config.bssid, manager.cache.bssid, sizeof(config.bssid));
+        sdk_wifi_set_channel(manager.cache.channel);
+    }
+
+    manager.cached_ip = false;
+    if (manager.config.ip) {
+        wifi_manager_set_ip(ipaddr_addr(manager.config.ip),
+                            ipaddr_addr(manager.config.netmask),
+                            ipaddr_addr(manager.config.gateway));
+    } else if (manager.fast && manager.config.reuse_lease && manager.cache.ip) {
+        wifi_manager_set_ip(manager.cache.ip, manager.cache.netmask, manager.cache.gateway);
+        manager.cached_ip = true;
+    } else {
+        sdk_wifi_station_dhcpc_start();
+    }
+
+    sdk_wifi_station_disconnect();
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_connect();
+
+    manager.state = wifi_manager_state_connecting;
+    manager.attempt_time = time_ms();
+}
+
+static void wifi_manager_connected() {
+    manager.state = wifi_manager_state_connected;
+    manager.backoff = WIFI_MANAGER_BACKOFF_MIN;
+
+    wifi_manager_save_cache();
+
+    if (!manager.ready) {
+        manager.ready = true;
+        manager.stats.connect_time = time_ms() - manager.start_time;
+        manager.stats.fast_connect = manager.fast;
+
+        printf("WiFi connected in %ums%s\n", manager.stats.connect_time,
+               manager.fast ? " (cached access point)" : "");
+
+        if (manager.config.on_ready)
+            manager.config.on_ready();
+    }
+}
+
+static void wifi_manager_task(void *_args) {
+    wifi_manager_connect(true);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WIFI_MANAGER_POLL_PERIOD));
+
+        uint8_t status = sdk_wifi_station_get_connect_status();
+        uint32_t now = time_ms();
+
+        switch (manager.state) {
+            case wifi_manager_state_connecting: {
+                if (status == STATION_GOT_IP) {
+                    wifi_manager_connected();
+                    break;
+                }
+
+                bool failed = status == STATION_WRONG_PASSWORD ||
+                              status == STATION_NO_AP_FOUND ||
+                              status == STATION_CONNECT_FAIL;
+                uint32_t timeout = manager.fast ? WIFI_MANAGER_FAST_TIMEOUT : WIFI_MANAGER_CONNECT_TIMEOUT;
+                if (!failed && now - manager.attempt_time < timeout)
+                    break;
+
+                if (manager.fast) {
+                    // Access point moved or lease is no longer valid, do it the slow way
+                    printf("WiFi fast connect failed, scanning\n");
+                    wifi_manager_connect(false);
+                    break;
+                }
+
+                manager.stats.attempts++;
+                printf("WiFi connect failed (status %d), retrying in %ums\n", status, manager.backoff);
+
+                sdk_wifi_station_disconnect();
+                manager.state = wifi_manager_state_waiting;
+                manager.attempt_time = now;
+                break;
+            }
+            case wifi_manager_state_waiting:
+                if (now - manager.attempt_time < manager.backoff)
+                    break;
+
+                manager.backoff *= 2;
+                if (manager.backoff > WIFI_MANAGER_BACKOFF_MAX)
+                    manager.backoff = WIFI_MANAGER_BACKOFF_MAX;
+
+                wifi_manager_connect(true);
+                break;
+            case wifi_manager_state_connected:
+                if (status == STATION_GOT_IP)
+                    break;
+
+                // SDK reconnects on its own, step in only if that fails
+                printf("WiFi connection lost\n");
+                manager.stats.reconnects++;
+                manager.fast = false;
+                manager.state = wifi_manager_state_connecting;
+                manager.attempt_time = now;
+                break;
+        }
+    }
+}
+
+int wifi_manager_start(const wifi_manager_config_t *config) {
+    if (manager.task)
+        return 0;
+
+    manager.config = *config;
+    manager.backoff = WIFI_MANAGER_BACKOFF_MIN;
+    manager.start_time = time_ms();
+
+    wifi_manager_load_cache();
+
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_set_event_handler_cb(wifi_manager_event);
+
+    if (xTaskCreate(wifi_manager_task, "WiFi", WIFI_MANAGER_TASK_STACK, NULL,
+                    WIFI_MANAGER_TASK_PRIORITY, &manager.task) != pdPASS) {
+        printf("Failed to create WiFi manager task\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void wifi_manager_get_stats(wifi_manager_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = manager.stats;
+    taskEXIT_CRITICAL();
+}
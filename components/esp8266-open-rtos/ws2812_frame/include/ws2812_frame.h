@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+#include <ws2812_i2s/ws2812_i2s.h>
+
+// Per channel transform applied to every pixel of a frame before it is sent
+// to the strip: out = gamma[in * brightness / 255].
+typedef struct {
+    const uint8_t *gamma;   // 256 entry table, NULL for linear output
+    uint8_t brightness;
+    bool identity;
+    uint8_t lut[256];
+} ws2812_frame_pipeline_t;
+
+void ws2812_frame_pipeline_init(ws2812_frame_pipeline_t *pipeline, const uint8_t *gamma, uint8_t brightness);
+void ws2812_frame_pipeline_set_brightness(ws2812_frame_pipeline_t *pipeline, uint8_t brightness);
+void ws2812_frame_pipeline_set_gamma(ws2812_frame_pipeline_t *pipeline, const uint8_t *gamma);
+
+// Transforms count pixels from src to dst in one pass. src and dst may be the same buffer.
+void ws2812_frame_render(const ws2812_frame_pipeline_t *pipeline,
+                         const ws2812_pixel_t *src, ws2812_pixel_t *dst, size_t count);
+
+// Transforms a single color once and writes it to count pixels of dst.
+void ws2812_frame_fill(const ws2812_frame_pipeline_t *pipeline,
+                       ws2812_pixel_t color, ws2812_pixel_t *dst, size_t count);
+
+
+// Front/back frame buffer for strips shared by several tasks.
+// Tasks render into the back buffer between ws2812_frame_begin() and
+// ws2812_frame_end(); the back buffer keeps its content between frames,
+// so incremental rendering works. On ws2812_frame_end() the back buffer
+// (run through the optional pipeline) becomes the front buffer and is sent
+// to the strip, unless it is identical to what is already displayed.
+typedef struct {
+    size_t count;
+    pixeltype_t type;
+    const ws2812_frame_pipeline_t *pipeline;
+
+    ws2812_pixel_t *back;
+    ws2812_pixel_t *front;
+    bool force_update;
+
+    SemaphoreHandle_t lock;
+
+    uint32_t frames_sent;
+    uint32_t frames_skipped;
+} ws2812_frame_buffer_t;
+
+int ws2812_frame_buffer_init(ws2812_frame_buffer_t *buffer, size_t count, pixeltype_t type,
+                             const ws2812_frame_pipeline_t *pipeline);
+
+// Forces next ws2812_frame_end() to send the frame even if it did not change,
+// e.g. after the strip lost power. Not needed after a pipeline brightness or
+// gamma change: frames are compared after the transform, so those are sent.
+void ws2812_frame_invalidate(ws2812_frame_buffer_t *buffer);
+
+// Locks the buffer and returns back buffer to render into.
+ws2812_pixel_t *ws2812_frame_begin(ws2812_frame_buffer_t *buffer);
+
+// Publishes back buffer and unlocks the buffer. Returns true if frame was sent to the strip.
+bool ws2812_frame_end(ws2812_frame_buffer_t *buffer);
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ws2812_frame.h>
+
+static void pipeline_rebuild(ws2812_frame_pipeline_t *pipeline) {
+    uint8_t brightness = pipeline->brightness;
+
+    for (int i = 0; i < 256; i++) {
+        uint8_t value = (i * brightness + 127) / 255;
+        pipeline->lut[i] = pipeline->gamma ? pipeline->gamma[value] : value;
+    }
+
+    pipeline->identity = (brightness == 255 && !pipeline->gamma);
+}
+
+void ws2812_frame_pipeline_init(ws2812_frame_pipeline_t *pipeline, const uint8_t *gamma, uint8_t brightness) {
+    pipeline->gamma = gamma;
+    pipeline->brightness = brightness;
+    pipeline_rebuild(pipeline);
+}
+
+void ws2812_frame_pipeline_set_brightness(ws2812_frame_pipeline_t *pipeline, uint8_t brightness) {
+    if (pipeline->brightness == brightness)
+        return;
+
+    pipeline->brightness = brightness;
+    pipeline_rebuild(pipeline);
+}
+
+void ws2812_frame_pipeline_set_gamma(ws2812_frame_pipeline_t *pipeline, const uint8_t *gamma) {
+    if (pipeline->gamma == gamma)
+        return;
+
+    pipeline->gamma = gamma;
+    pipeline_rebuild(pipeline);
+}
+
+static inline uint32_t transform(const uint8_t *lut, uint32_t pixel) {
+    return (uint32_t)lut[pixel & 0xff]
+        | ((uint32_t)lut[(pixel >> 8) & 0xff] << 8)
+        | ((uint32_t)lut[(pixel >> 16) & 0xff] << 16)
+        | ((uint32_t)lut[pixel >> 24] << 24);
+}
+
+void ws2812_frame_render(const ws2812_frame_pipeline_t *pipeline,
+                         const ws2812_pixel_t *src, ws2812_pixel_t *dst, size_t count) {
+    if (pipeline->identity) {
+        if (src != dst)
+            memcpy(dst, src, count * sizeof(ws2812_pixel_t));
+        return;
+    }
+
+    const uint8_t *lut = pipeline->lut;
+    for (size_t i = 0; i < count; i++) {
+        dst[i].color = transform(lut, src[i].color);
+    }
+}
+
+void ws2812_frame_fill(const ws2812_frame_pipeline_t *pipeline,
+                       ws2812_pixel_t color, ws2812_pixel_t *dst, size_t count) {
+    uint32_t value = transform(pipeline->lut, color.color);
+
+    for (size_t i = 0; i < count; i++) {
+        dst[i].color = value;
+    }
+}
+
+
+int ws2812_frame_buffer_init(ws2812_frame_buffer_t *buffer, size_t count, pixeltype_t type,
+                             const ws2812_frame_pipeline_t *pipeline) {
+    buffer->count = count;
+    buffer->type = type;
+    buffer->pipeline = pipeline;
+    buffer->force_update = true;
+    buffer->frames_sent = 0;
+    buffer->frames_skipped = 0;
+
+    buffer->back = calloc(count, sizeof(ws2812_pixel_t));
+    buffer->front = calloc(count, sizeof(ws2812_pixel_t));
+    buffer->lock = xSemaphoreCreateMutex();
+    if (!buffer->back || !buffer->front || !buffer->lock) {
+        printf("Failed to allocate frame buffer for %u pixels\n", (unsigned) count);
+        free(buffer->back);
+        free(buffer->front);
+        if (buffer->lock)
+            vSemaphoreDelete(buffer->lock);
+        buffer->back = buffer->front = NULL;
+        buffer->lock = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void ws2812_frame_invalidate(ws2812_frame_buffer_t *buffer) {
+    buffer->force_update = true;
+}
+
+ws2812_pixel_t *ws2812_frame_begin(ws2812_frame_buffer_t *buffer) {
+    xSemaphoreTake(buffer->lock, portMAX_DELAY);
+    return buffer->back;
+}
+
+bool ws2812_frame_end(ws2812_frame_buffer_t *buffer) {
+    const ws2812_pixel_t *back = buffer->back;
+    ws2812_pixel_t *front = buffer->front;
+    bool changed = buffer->force_update;
+
+    // Transform, compare and copy in a single pass over the frame
+    if (buffer->pipeline && !buffer->pipeline->identity) {
+        const uint8_t *lut = buffer->pipeline->lut;
+        for (size_t i = 0; i < buffer->count; i++) {
+            uint32_t value = transform(lut, back[i].color);
+            if (front[i].color != value) {
+                front[i].color = value;
+                changed = true;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < buffer->count; i++) {
+            if (front[i].color != back[i].color) {
+                front[i].color = back[i].color;
+                changed = true;
+            }
+        }
+    }
+
+    if (changed) {
+        ws2812_i2s_update(front, buffer->type);
+        buffer->force_update = false;
+        buffer->frames_sent++;
+    } else {
+        buffer->frames_skipped++;
+    }
+
+    xSemaphoreGive(buffer->lock);
+
+    return changed;
+}
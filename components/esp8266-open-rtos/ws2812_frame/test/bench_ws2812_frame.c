@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ws2812_frame.h>
+
+// Pixels per second through the frame pipeline for a few strip lengths.
+// "per pixel" is the brightness-then-gamma loop the examples used before
+// the pipeline, one channel at a time; "render" and "fill" are the single
+// pass table transforms; "end changed" and "end static" are a full
+// ws2812_frame_end() with the I2S transmit stubbed out, for a frame that
+// differs from the displayed one and for one that does not. Host numbers
+// are only useful to compare the variants, not as device timings.
+
+#define MIN_PIXELS 20000000
+
+static const size_t strip_lengths[] = { 16, 60, 300, 1000 };
+
+static uint8_t gamma_table[256];
+static uint32_t updates;
+
+void ws2812_i2s_update(ws2812_pixel_t *pixels, pixeltype_t type) {
+    updates++;
+}
+
+static uint64_t time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void per_pixel(const uint8_t *gamma, uint8_t brightness,
+                      const ws2812_pixel_t *src, ws2812_pixel_t *dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i].red = gamma[(src[i].red * brightness + 127) / 255];
+        dst[i].green = gamma[(src[i].green * brightness + 127) / 255];
+        dst[i].blue = gamma[(src[i].blue * brightness + 127) / 255];
+        dst[i].white = gamma[(src[i].white * brightness + 127) / 255];
+    }
+}
+
+static void report(const char *name, size_t count, uint32_t frames, uint64_t ns) {
+    double seconds = (double)ns / 1e9;
+    printf("%-12s %5u leds %10.1f Mpixels/s %10.0f frames/s\n",
+           name, (unsigned)count, count * frames / seconds / 1e6, frames / seconds);
+}
+
+static void bench(size_t count) {
+    ws2812_pixel_t *src = malloc(count * sizeof(ws2812_pixel_t));
+    ws2812_pixel_t *dst = malloc(count * sizeof(ws2812_pixel_t));
+    if (!src || !dst) {
+        printf("Failed to allocate %u pixels\n", (unsigned)count);
+        exit(1);
+    }
+
+    uint32_t seed = 1;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i].color = seed;
+    }
+
+    ws2812_frame_pipeline_t pipeline;
+    ws2812_frame_pipeline_init(&pipeline, gamma_table, 180);
+
+    uint32_t frames = MIN_PIXELS / count;
+    uint64_t start;
+
+    start = time_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        per_pixel(gamma_table, 180, src, dst, count);
+        __asm__ volatile("" : : "r"(dst) : "memory");
+    }
+    report("per pixel", count, frames, time_ns() - start);
+
+    start = time_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        ws2812_frame_render(&pipeline, src, dst, count);
+        __asm__ volatile("" : : "r"(dst) : "memory");
+    }
+    report("render", count, frames, time_ns() - start);
+
+    start = time_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        ws2812_frame_fill(&pipeline, src[frame % count], dst, count);
+        __asm__ volatile("" : : "r"(dst) : "memory");
+    }
+    report("fill", count, frames, time_ns() - start);
+
+    ws2812_frame_buffer_t buffer;
+    if (ws2812_frame_buffer_init(&buffer, count, PIXEL_RGB, &pipeline)) {
+        exit(1);
+    }
+
+    // Alternate two frames so every end has to transmit
+    updates = 0;
+    start = time_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        ws2812_pixel_t *back = ws2812_frame_begin(&buffer);
+        back[0].color = frame & 1 ? 0xffffffff : 0;
+        ws2812_frame_end(&buffer);
+    }
+    report("end changed", count, frames, time_ns() - start);
+    if (updates != frames) {
+        printf("FAILED: %u of %u changed frames sent\n", updates, frames);
+        exit(1);
+    }
+
+    updates = 0;
+    start = time_ns();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        ws2812_frame_begin(&buffer);
+        ws2812_frame_end(&buffer);
+    }
+    report("end static", count, frames, time_ns() - start);
+    if (updates != 0) {
+        printf("FAILED: %u static frames sent\n", updates);
+        exit(1);
+    }
+
+    free(buffer.back);
+    free(buffer.front);
+    vSemaphoreDelete(buffer.lock);
+    free(src);
+    free(dst);
+}
+
+int main() {
+    for (int i = 0; i < 256; i++) {
+        gamma_table[i] = (i * i + 254) / 255;
+    }
+
+    for (size_t i = 0; i < sizeof(strip_lengths) / sizeof(*strip_lengths); i++) {
+        bench(strip_lengths[i]);
+    }
+
+    return 0;
+}
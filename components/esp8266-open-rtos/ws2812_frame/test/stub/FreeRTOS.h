@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS header, only what ws2812_frame uses.
+
+#include <stdint.h>
+
+#define portMAX_DELAY 0xffffffffUL
@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS semaphores. The benchmark is single
+// threaded, so the mutex only has to exist.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef void *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return malloc(1);
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    free(semaphore);
+}
+
+static inline int xSemaphoreTake(SemaphoreHandle_t semaphore, uint32_t ticks) {
+    return 1;
+}
+
+static inline int xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return 1;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for the esp-open-rtos extras header. ws2812_i2s_update()
+// is provided by the benchmark so that frame submission can be counted
+// without any hardware.
+
+#include <stdint.h>
+
+typedef union {
+    struct {
+        uint8_t blue;
+        uint8_t green;
+        uint8_t red;
+        uint8_t white;
+    };
+    uint32_t color;
+} ws2812_pixel_t;
+
+typedef enum {
+    PIXEL_RGB = 12,
+    PIXEL_RGBW = 16
+} pixeltype_t;
+
+void ws2812_i2s_update(ws2812_pixel_t *pixels, pixeltype_t type);
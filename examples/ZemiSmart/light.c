@@ -21,62 +21,22 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
-#include <math.h>  //requires LIBS ?= hal m to be added to Makefile
+#include <color.h>
 #include "mjpwm.h"
 
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
-}
-
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-void hsi2rgbw(float h, float s, float i, int* rgbw) {
-    int r, g, b, w;
-    float cos_h, cos_1047_h;
-    //h = fmod(h,360); // cycle h around to 0-360 degrees
-    h = 3.14159*h/(float)180; // Convert to radians.
-    s /=(float)100; i/=(float)100; //from percentage to ratio
-    s = s>0?(s<1?s:1):0; // clamp s and i to interval [0,1]
-    i = i>0?(i<1?i:1):0;
-    i = i*sqrt(i); //shape intensity to have finer granularity near 0
-
-    if(h < 2.09439) {
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        r = s*4095*i/3*(1+cos_h/cos_1047_h);
-        g = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        b = 0;
-        w = 4095*(1-s)*i;
-    } else if(h < 4.188787) {
-        h = h - 2.09439;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        g = s*4095*i/3*(1+cos_h/cos_1047_h);
-        b = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        r = 0;
-        w = 4095*(1-s)*i;
-    } else {
-        h = h - 4.188787;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        b = s*4095*i/3*(1+cos_h/cos_1047_h);
-        r = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        g = 0;
-        w = 4095*(1-s)*i;
-    }
-
-    rgbw[0]=r;
-    rgbw[1]=g;
-    rgbw[2]=b;
-    rgbw[3]=w;
+    wifi_manager_start(&wifi_config);
 }
 
 #define PIN_DI 				13
@@ -86,14 +46,14 @@ float hue,sat,bri;
 bool on;
 
 void lightSET(void) {
-    int rgbw[4];
+    color_rgbw_t rgbw;
     if (on) {
         printf("h=%d,s=%d,b=%d => ",(int)hue,(int)sat,(int)bri);
         
-        hsi2rgbw(hue,sat,bri,rgbw);
-        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
+        color_hsi2rgbw(hue,sat,bri,4095,COLOR_FLAG_SHAPE_INTENSITY,&rgbw);
+        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw.red,rgbw.green,rgbw.blue,rgbw.white);
         
-        mjpwm_send_duty(rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
+        mjpwm_send_duty(rgbw.red,rgbw.green,rgbw.blue,rgbw.white);
     } else {
         printf("off\n");
         mjpwm_send_duty(     0,      0,      0,      0 );
@@ -232,10 +192,13 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
     wifi_init();
     light_init();
-    homekit_server_init(&config);
 }
@@ -11,6 +11,7 @@
  *     2017/12/24, adapted for esp-open-rtos
 *******************************************************************************/
 #include "mjpwm.h"
+#include <string.h>
 #include <espressif/esp_misc.h>  //defines sdk_os_delay_us
 #include <task.h>
 #include <esp/gpio.h>
@@ -43,6 +44,12 @@ static uint8_t pin_dcki = 15;
 
 static mjpwm_cmd_t mjpwm_commands[GPIO_MAX_INDEX + 1];
 
+// Duty bits per channel for the last command sent
+static uint8_t bit_length = 8;
+
+// Words of a duty frame encoded as a bitstream (MSB first)
+#define MJPWM_FRAME_WORDS ((MJPWM_MAX_CHIPS * 4 * 16 + 31) / 32)
+
 IRAM void mjpwm_di_pulse(uint16_t times)
 {
     uint16_t i;
@@ -72,6 +79,22 @@ void mjpwm_send_command(mjpwm_cmd_t command)
     uint8_t command_data;
     mjpwm_commands[pin_dcki] = command;
 
+    switch (command.bit_width) {
+    case MJPWM_CMD_BIT_WIDTH_16:
+        bit_length = 16;
+        break;
+    case MJPWM_CMD_BIT_WIDTH_14:
+        bit_length = 14;
+        break;
+    case MJPWM_CMD_BIT_WIDTH_12:
+        bit_length = 12;
+        break;
+    case MJPWM_CMD_BIT_WIDTH_8:
+    default:
+        bit_length = 8;
+        break;
+    }
+
     taskENTER_CRITICAL(); //ets_intr_lock();
     // TStop > 12us.
     sdk_os_delay_us(12);
@@ -128,79 +151,65 @@ void mjpwm_send_command(mjpwm_cmd_t command)
     taskEXIT_CRITICAL(); //ets_intr_unlock();
 }
 
-IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
-        uint16_t duty_b, uint16_t duty_w)
+// Encodes 4 duties per chip into frame_bits, returns number of bits
+static uint16_t mjpwm_encode_frame(const uint16_t *duty, uint32_t *frame_bits)
 {
-    uint8_t i = 0, n;
-    uint8_t channel = 0;
-    uint8_t bit_length = 8;
-    uint16_t duty_current = 0;
+    uint16_t count = 0;
 
-    // Definition for RGBW channels
-    uint16_t duty[4] = { duty_r, duty_g, duty_b, duty_w };
+    memset(frame_bits, 0, MJPWM_FRAME_WORDS * sizeof(uint32_t));
+    for (uint8_t i = 0; i < nc * 4; i++) {
+        for (int8_t bit = bit_length - 1; bit >= 0; bit--, count++) {
+            if (duty[i] & (1 << bit))
+                frame_bits[count >> 5] |= 0x80000000 >> (count & 31);
+        }
+    }
 
-    switch (mjpwm_commands[pin_dcki].bit_width) {
-    case MJPWM_CMD_BIT_WIDTH_16:
-        bit_length = 16;
-        break;
-    case MJPWM_CMD_BIT_WIDTH_14:
-        bit_length = 14;
-        break;
-    case MJPWM_CMD_BIT_WIDTH_12:
-        bit_length = 12;
-        break;
-    case MJPWM_CMD_BIT_WIDTH_8:
-        bit_length = 8;
-        break;
-    default:
-        bit_length = 8;
-        break;
+    return count;
+}
+
+// Shifts out prepared bitstream, two bits per DCKI pulse (on both edges),
+// with direct GPIO register writes
+static IRAM void mjpwm_emit_frame(const uint32_t *frame_bits, uint16_t count)
+{
+    const uint32_t di = BIT(pin_di);
+    const uint32_t dcki = BIT(pin_dcki);
+
+    for (uint16_t i = 0; i < count; i += 2) {
+        uint32_t word = frame_bits[i >> 5] << (i & 31);
+
+        // DCK = 0; DI = bit
+        GPIO.OUT_CLEAR = dcki;
+        if (word & 0x80000000)
+            GPIO.OUT_SET = di;
+        else
+            GPIO.OUT_CLEAR = di;
+
+        // DCK = 1; DI = next bit
+        GPIO.OUT_SET = dcki;
+        if (word & 0x40000000)
+            GPIO.OUT_SET = di;
+        else
+            GPIO.OUT_CLEAR = di;
+
+        // DCK = 0; DI = 0
+        GPIO.OUT_CLEAR = dcki;
+        GPIO.OUT_CLEAR = di;
     }
+}
+
+IRAM void mjpwm_send_frame(const uint16_t *duty)
+{
+    // Everything that does not need exact timing is done before entering critical section.
+    // Frame is on the stack so concurrent senders don't overwrite each other's bits.
+    uint32_t frame_bits[MJPWM_FRAME_WORDS];
+    uint16_t count = mjpwm_encode_frame(duty, frame_bits);
 
     taskENTER_CRITICAL(); //ets_intr_lock();
     // TStop > 12us.
     sdk_os_delay_us(12);
     asm("nop;nop;");
 
-    for (n = 0; n < nc; n++)
-    {
-        for (channel = 0; channel < 4; channel++)   //RGBW 4CH
-        {
-            // RGBW Channel
-            duty_current = duty[channel];
-            // Send 8bit/12bit/14bit/16bit Data
-            for (i = 0; i < bit_length / 2; i++) {
-
-                // DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                // DCK = 1;
-                MJPWM_DIRECT_WRITE_HIGH(pin_dcki);
-                duty_current = duty_current << 1;
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                //DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                //DI = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_di);
-
-                duty_current = duty_current << 1;
-            }
-        }
-    }
+    mjpwm_emit_frame(frame_bits, count);
 
     // TStart > 12us. Ready for send DI pulse.
     sdk_os_delay_us(12);
@@ -212,6 +221,22 @@ IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
     taskEXIT_CRITICAL(); //ets_intr_unlock();
 }
 
+IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
+        uint16_t duty_b, uint16_t duty_w)
+{
+    uint16_t duty[MJPWM_MAX_CHIPS * 4];
+
+    // Same RGBW duty for every chip
+    for (uint8_t n = 0; n < nc; n++) {
+        duty[n * 4 + 0] = duty_r;
+        duty[n * 4 + 1] = duty_g;
+        duty[n * 4 + 2] = duty_b;
+        duty[n * 4 + 3] = duty_w;
+    }
+
+    mjpwm_send_frame(duty);
+}
+
 void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
 {
     pin_di = di;
@@ -224,7 +249,7 @@ void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
     MJPWM_DIRECT_WRITE_LOW(pin_di);
     MJPWM_DIRECT_WRITE_LOW(pin_dcki);
 
-    nc = n_chips;
+    nc = (n_chips > MJPWM_MAX_CHIPS) ? MJPWM_MAX_CHIPS : n_chips;
 
     // Clear all duty register
     mjpwm_dcki_pulse(32 * nc);
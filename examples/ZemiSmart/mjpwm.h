@@ -16,6 +16,11 @@
 
 #include <FreeRTOS.h>  //added for esp-open-rtos
 
+// Max number of chained chips
+#ifndef MJPWM_MAX_CHIPS
+#define MJPWM_MAX_CHIPS 8
+#endif
+
 typedef enum mjpwm_cmd_one_shot_t {
     MJPWM_CMD_ONE_SHOT_DISABLE = 0X00,
     MJPWM_CMD_ONE_SHOT_ENFORCE = 0X01,
@@ -69,5 +74,10 @@ void mjpwm_di_pulse(uint16_t times);
 void mjpwm_dcki_pulse(uint16_t times);
 void mjpwm_send_command(mjpwm_cmd_t command);
 void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g, uint16_t duty_b, uint16_t duty_w);
+// Sends RGBW duty for each chained chip (n_chips passed to mjpwm_init), in the order they are shifted out
+// (first 4 values end up in the last chip of the chain). Pins have to be GPIO0..GPIO15.
+// The frame is encoded on the caller's stack and shifted out in a critical section, so frames can be
+// sent from several tasks. Don't send a command concurrently, the frame may be encoded for the old bit width.
+void mjpwm_send_frame(const uint16_t *duty);
 
 #endif /* __MJPWM_H__ */
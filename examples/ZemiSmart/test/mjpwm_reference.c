@@ -0,0 +1,76 @@
+// mjpwm_send_duty() as it was before the frame was pre-encoded: every bit
+// is written with gpio_write() inside the critical section. Replayed next
+// to the current driver as the reference waveform.
+
+#include <espressif/esp_misc.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/gpio.h>
+
+#include "mjpwm_reference.h"
+
+void mjpwm_reference_send_duty(uint8_t nc, uint8_t pin_di, uint8_t pin_dcki, uint8_t bit_length,
+                               uint16_t duty_r, uint16_t duty_g, uint16_t duty_b, uint16_t duty_w)
+{
+    uint8_t i = 0, n;
+    uint8_t channel = 0;
+    uint16_t duty_current = 0;
+
+    // Definition for RGBW channels
+    uint16_t duty[4] = { duty_r, duty_g, duty_b, duty_w };
+
+    taskENTER_CRITICAL(); //ets_intr_lock();
+    // TStop > 12us.
+    sdk_os_delay_us(12);
+
+    for (n = 0; n < nc; n++)
+    {
+        for (channel = 0; channel < 4; channel++)   //RGBW 4CH
+        {
+            // RGBW Channel
+            duty_current = duty[channel];
+            // Send 8bit/12bit/14bit/16bit Data
+            for (i = 0; i < bit_length / 2; i++) {
+
+                // DCK = 0;
+                gpio_write(pin_dcki, 0);
+                if (duty_current & (0x01 << (bit_length - 1))) {
+                    // DI = 1;
+                    gpio_write(pin_di, 1);
+                } else {
+                    // DI = 0;
+                    gpio_write(pin_di, 0);
+                }
+
+                // DCK = 1;
+                gpio_write(pin_dcki, 1);
+                duty_current = duty_current << 1;
+                if (duty_current & (0x01 << (bit_length - 1))) {
+                    // DI = 1;
+                    gpio_write(pin_di, 1);
+                } else {
+                    // DI = 0;
+                    gpio_write(pin_di, 0);
+                }
+
+                //DCK = 0;
+                gpio_write(pin_dcki, 0);
+                //DI = 0;
+                gpio_write(pin_di, 0);
+
+                duty_current = duty_current << 1;
+            }
+        }
+    }
+
+    // TStart > 12us. Ready for send DI pulse.
+    sdk_os_delay_us(12);
+    // Send 8 DI pulse. After 8 pulse falling edge, store old data.
+    for (i = 0; i < 8; i++) {
+        gpio_write(pin_di, 1);
+        gpio_write(pin_di, 0);
+    }
+    // TStop > 12us.
+    sdk_os_delay_us(12);
+    taskEXIT_CRITICAL(); //ets_intr_unlock();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+void mjpwm_reference_send_duty(uint8_t nc, uint8_t pin_di, uint8_t pin_dcki, uint8_t bit_length,
+                               uint16_t duty_r, uint16_t duty_g, uint16_t duty_b, uint16_t duty_w);
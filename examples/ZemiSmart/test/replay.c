@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp/gpio.h>
+
+#include "mjpwm.h"
+#include "mjpwm_reference.h"
+
+// Replays the waveform mjpwm_send_frame() and mjpwm_send_duty() generate,
+// as logged by the stand-in GPIO, delay and critical section calls in
+// stub/, and decodes it the way a MY9291/MY9231 chain reads it: DI is
+// sampled on both DCKI edges, more than 12us of silence followed by 8 DI
+// pulses latches the shifted data. Checks that:
+//  - the decoded bits are the duties, MSB first, at the configured width
+//  - the waveform matches the gpio_write() implementation it replaced
+//  - TStop/TStart gaps are at least 12us, 8 latch pulses with DCKI low
+//  - DCKI only toggles while shifting data, both lines end low
+//  - all of it happens inside one critical section
+
+#define PIN_DI 13
+#define PIN_DCKI 15
+#define MAX_BITS (MJPWM_MAX_CHIPS * 4 * 16)
+
+sim_event_t sim_events[SIM_MAX_EVENTS];
+int sim_event_count;
+sim_gpio_t GPIO;
+
+int sim_event(sim_event_type_t type, uint32_t value, bool level) {
+    if (sim_event_count >= SIM_MAX_EVENTS) {
+        printf("Event log overflow\n");
+        exit(1);
+    }
+
+    sim_events[sim_event_count] = (sim_event_t) { type, value, level };
+    return sim_event_count++;
+}
+
+typedef struct {
+    int bits;
+    uint8_t bit[MAX_BITS];
+    int latch_pulses;
+    int gpio_writes;        // register writes while interrupts are off
+    uint32_t delay_us;      // busy waits while interrupts are off
+    const char *error;
+} waveform_t;
+
+static int failures = 0;
+
+static void decode(waveform_t *w) {
+    const uint32_t di = BIT(PIN_DI), dcki = BIT(PIN_DCKI);
+    uint32_t level = 0;
+    int segment = -1;       // -1 before the first gap, 0 data, 1 latch, 2 after
+    bool critical = false;
+    int critical_sections = 0;
+
+    memset(w, 0, sizeof(*w));
+
+    for (int i = 0; i < sim_event_count; i++) {
+        const sim_event_t *e = &sim_events[i];
+        uint32_t previous = level;
+
+        switch (e->type) {
+            case SIM_CRITICAL_ENTER:
+                critical = true;
+                critical_sections++;
+                continue;
+            case SIM_CRITICAL_EXIT:
+                critical = false;
+                continue;
+            case SIM_DELAY:
+                if (e->value < 12)
+                    w->error = "gap shorter than 12us";
+                if (!critical)
+                    w->error = "delay outside of critical section";
+                w->delay_us += e->value;
+                segment++;
+                continue;
+            case SIM_OUT_SET:
+                level |= GPIO.out_set[i];
+                break;
+            case SIM_OUT_CLEAR:
+                level &= ~GPIO.out_clear[i];
+                break;
+            case SIM_WRITE:
+                level = e->level ? level | e->value : level & ~e->value;
+                break;
+        }
+
+        if (!critical)
+            w->error = "GPIO write outside of critical section";
+        w->gpio_writes++;
+
+        bool dcki_edge = (previous ^ level) & dcki;
+        bool di_rise = !(previous & di) && (level & di);
+
+        if (segment != 0 && dcki_edge)
+            w->error = "DCKI toggled outside of data";
+        if (segment < 0 || segment > 1) {
+            if ((previous ^ level) & di)
+                w->error = "DI toggled outside of data and latch";
+            continue;
+        }
+
+        if (segment == 0) {
+            if (dcki_edge) {
+                if (w->bits >= MAX_BITS) {
+                    w->error = "too many bits";
+                    continue;
+                }
+                w->bit[w->bits++] = (level & di) ? 1 : 0;
+            }
+        } else if (di_rise) {
+            if (level & dcki)
+                w->error = "DCKI high during latch";
+            w->latch_pulses++;
+        }
+    }
+
+    if (critical_sections != 1)
+        w->error = "expected exactly one critical section";
+    if (segment != 2)
+        w->error = "expected TStop, TStart and TStop gaps";
+    if (level & (di | dcki))
+        w->error = "lines not low at the end";
+    if (w->latch_pulses != 8 && !w->error)
+        w->error = "expected 8 latch pulses";
+}
+
+static void expect_bits(const char *name, const waveform_t *w, const uint16_t *duty, int count, int width) {
+    if (w->error) {
+        printf("FAIL: %s: %s\n", name, w->error);
+        failures++;
+        return;
+    }
+    if (w->bits != count * width) {
+        printf("FAIL: %s: %d bits, expected %d\n", name, w->bits, count * width);
+        failures++;
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint16_t value = 0;
+        for (int b = 0; b < width; b++)
+            value = (value << 1) | w->bit[i * width + b];
+
+        uint16_t expected = duty[i] & ((1u << width) - 1);
+        if (value != expected) {
+            printf("FAIL: %s: channel %d decoded 0x%04x, expected 0x%04x\n", name, i, value, expected);
+            failures++;
+            return;
+        }
+    }
+}
+
+static mjpwm_cmd_t command(mjpwm_cmd_bit_width_t bit_width) {
+    return (mjpwm_cmd_t) {
+        .scatter = MJPWM_CMD_SCATTER_APDM,
+        .frequency = MJPWM_CMD_FREQUENCY_DIVIDE_1,
+        .bit_width = bit_width,
+        .reaction = MJPWM_CMD_REACTION_FAST,
+        .one_shot = MJPWM_CMD_ONE_SHOT_DISABLE,
+        .resv = 0,
+    };
+}
+
+static const struct {
+    mjpwm_cmd_bit_width_t bit_width;
+    uint8_t bits;
+} widths[] = {
+    { MJPWM_CMD_BIT_WIDTH_8, 8 },
+    { MJPWM_CMD_BIT_WIDTH_12, 12 },
+    { MJPWM_CMD_BIT_WIDTH_14, 14 },
+    { MJPWM_CMD_BIT_WIDTH_16, 16 },
+};
+
+static const uint8_t chip_counts[] = { 1, 2, MJPWM_MAX_CHIPS };
+
+int main() {
+    char name[64];
+    srand(1);
+
+    printf("%-18s %12s %12s %10s\n", "", "bits", "GPIO writes", "delay");
+    for (size_t wi = 0; wi < sizeof(widths) / sizeof(*widths); wi++) {
+        for (size_t ci = 0; ci < sizeof(chip_counts) / sizeof(*chip_counts); ci++) {
+            uint8_t chips = chip_counts[ci];
+            uint8_t width = widths[wi].bits;
+
+            mjpwm_init(PIN_DI, PIN_DCKI, chips, command(widths[wi].bit_width));
+
+            for (int round = 0; round < 50; round++) {
+                uint16_t rgbw[4] = { rand(), rand(), rand(), rand() };
+                if (round == 0)
+                    rgbw[0] = rgbw[1] = rgbw[2] = rgbw[3] = 0;
+                if (round == 1)
+                    rgbw[0] = rgbw[1] = rgbw[2] = rgbw[3] = 0xffff;
+
+                // Same duty on every chip, against the old implementation
+                waveform_t current, reference;
+                sim_event_count = 0;
+                mjpwm_send_duty(rgbw[0], rgbw[1], rgbw[2], rgbw[3]);
+                decode(&current);
+
+                sim_event_count = 0;
+                mjpwm_reference_send_duty(chips, PIN_DI, PIN_DCKI, width, rgbw[0], rgbw[1], rgbw[2], rgbw[3]);
+                decode(&reference);
+
+                uint16_t duty[MJPWM_MAX_CHIPS * 4];
+                for (int i = 0; i < chips * 4; i++)
+                    duty[i] = rgbw[i % 4];
+
+                snprintf(name, sizeof(name), "%u bit %u chips send_duty", width, chips);
+                expect_bits(name, &current, duty, chips * 4, width);
+                snprintf(name, sizeof(name), "%u bit %u chips reference", width, chips);
+                expect_bits(name, &reference, duty, chips * 4, width);
+                if (current.bits != reference.bits || memcmp(current.bit, reference.bit, current.bits) ||
+                        current.latch_pulses != reference.latch_pulses) {
+                    printf("FAIL: %u bit %u chips: waveform differs from reference\n", width, chips);
+                    failures++;
+                }
+
+                // Different duty per chip
+                for (int i = 0; i < chips * 4; i++)
+                    duty[i] = rand();
+                sim_event_count = 0;
+                mjpwm_send_frame(duty);
+                decode(&current);
+                snprintf(name, sizeof(name), "%u bit %u chips send_frame", width, chips);
+                expect_bits(name, &current, duty, chips * 4, width);
+
+                if (round == 2) {
+                    printf("%2u bit %u chip%s %7s %12d %12d %8uus\n", width, chips, chips > 1 ? "s" : " ",
+                           "current", current.bits, current.gpio_writes, current.delay_us);
+                    printf("%18s %12d %12d %8uus\n", "reference",
+                           reference.bits, reference.gpio_writes, reference.delay_us);
+                }
+            }
+        }
+    }
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+#include "sim.h"
+
+#define IRAM
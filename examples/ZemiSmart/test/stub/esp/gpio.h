@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+#define BIT(n) (1u << (n))
+
+typedef enum { GPIO_INPUT, GPIO_OUTPUT } gpio_direction_t;
+
+// GPIO.OUT_SET = mask stores mask in the slot of a new event
+typedef struct {
+    uint32_t out_set[SIM_MAX_EVENTS];
+    uint32_t out_clear[SIM_MAX_EVENTS];
+} sim_gpio_t;
+
+extern sim_gpio_t GPIO;
+
+#define OUT_SET out_set[sim_event(SIM_OUT_SET, 0, false)]
+#define OUT_CLEAR out_clear[sim_event(SIM_OUT_CLEAR, 0, false)]
+
+static inline void gpio_enable(uint8_t gpio_num, gpio_direction_t direction) {}
+
+static inline void gpio_write(uint8_t gpio_num, bool set) {
+    sim_event(SIM_WRITE, BIT(gpio_num), set);
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "sim.h"
+
+#define sdk_os_delay_us(us) sim_event(SIM_DELAY, (us), false)
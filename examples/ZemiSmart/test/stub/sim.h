@@ -0,0 +1,29 @@
+#pragma once
+
+// Event log the stand-in headers write to. Every GPIO write, delay and
+// critical section boundary becomes one event, in program order.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_MAX_EVENTS 16384
+
+typedef enum {
+    SIM_OUT_SET,
+    SIM_OUT_CLEAR,
+    SIM_WRITE,              // gpio_write()
+    SIM_DELAY,
+    SIM_CRITICAL_ENTER,
+    SIM_CRITICAL_EXIT,
+} sim_event_type_t;
+
+typedef struct {
+    sim_event_type_t type;
+    uint32_t value;         // pin mask for register writes and gpio_write(), us for delays
+    bool level;             // gpio_write()
+} sim_event_t;
+
+extern sim_event_t sim_events[SIM_MAX_EVENTS];
+extern int sim_event_count;
+
+int sim_event(sim_event_type_t type, uint32_t value, bool level);
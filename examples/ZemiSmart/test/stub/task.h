@@ -0,0 +1,6 @@
+#pragma once
+
+#include "sim.h"
+
+#define taskENTER_CRITICAL() sim_event(SIM_CRITICAL_ENTER, 0, false)
+#define taskEXIT_CRITICAL() sim_event(SIM_CRITICAL_EXIT, 0, false)
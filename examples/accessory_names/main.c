@@ -14,17 +14,19 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 const int led_gpio = 2;
@@ -109,6 +111,10 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
@@ -125,5 +131,4 @@ void user_init(void) {
 
     wifi_init();
     led_init();
-    homekit_server_init(&config);
 }
@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp8266.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "covering.h"
+
+#define COVERING_TASK_STACK 384
+#define COVERING_TASK_PRIORITY 2
+
+// Position is tracked in 1/100 of percent
+#define POSITION_MAX 10000
+
+// Extra travel time (in percent of full travel) when moving to an end
+#define HOMING_OVERRUN 10
+// While moving, positions are reported this often (in milliseconds)
+#define REPORT_INTERVAL 250
+// End stops are checked this often while moving towards them
+#define ENDSTOP_INTERVAL 20
+// Calibration gives up if an end stop isn't reached within this time
+#define CALIBRATION_TIMEOUT 120000
+
+typedef enum {
+    calibration_none = 0,
+    calibration_homing,
+    calibration_opening,
+    calibration_closing,
+} calibration_phase_t;
+
+typedef struct {
+    covering_config_t config;
+
+    int32_t position;               // at start_time
+    int32_t target;
+    int8_t direction;               // 1 opening, -1 closing, 0 stopped
+    bool manual;                    // running past the end, position is not tracked
+    uint32_t start_time;
+    uint32_t stop_time;
+
+    calibration_phase_t calibration;
+
+    uint8_t reported_position;
+    covering_state_t reported_state;
+} covering_channel_t;
+
+typedef struct {
+    uint8_t channel;
+    uint8_t position;
+    covering_state_t state;
+} covering_report_t;
+
+typedef struct {
+    covering_channel_t channels[COVERING_MAX_CHANNELS];
+    uint8_t count;
+    covering_callback_fn callback;
+
+    TaskHandle_t task;
+    SemaphoreHandle_t lock;
+} covering_t;
+
+static covering_t covering;
+
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void covering_motor(covering_channel_t *ch, int8_t direction) {
+    // Release before engaging, never drive both relays at once
+    if (direction <= 0)
+        gpio_write(ch->config.open_gpio, false);
+    if (direction >= 0)
+        gpio_write(ch->config.close_gpio, false);
+
+    if (direction > 0)
+        gpio_write(ch->config.open_gpio, true);
+    else if (direction < 0)
+        gpio_write(ch->config.close_gpio, true);
+}
+
+static uint32_t covering_travel_time(const covering_channel_t *ch, int8_t direction) {
+    return direction > 0 ? ch->config.open_time : ch->config.close_time;
+}
+
+static uint8_t covering_endstop_gpio(const covering_channel_t *ch, int8_t direction) {
+    return direction > 0 ? ch->config.open_endstop_gpio : ch->config.close_endstop_gpio;
+}
+
+static bool covering_endstop_hit(const covering_channel_t *ch) {
+    uint8_t gpio = covering_endstop_gpio(ch, ch->direction);
+    return gpio != COVERING_NO_GPIO && gpio_read(gpio) == ch->config.endstop_value;
+}
+
+static int32_t covering_position_at(const covering_channel_t *ch, uint32_t now) {
+    if (!ch->direction || ch->manual)
+        return ch->position;
+
+    uint32_t travel_time = covering_travel_time(ch, ch->direction);
+    int32_t elapsed = now - ch->start_time - ch->config.lag;
+    if (elapsed <= 0)
+        return ch->position;
+    if ((uint32_t)elapsed > travel_time)
+        elapsed = travel_time;
+
+    // Computed from the start of the move, so rounding never accumulates
+    int32_t position = ch->position + ch->direction * (int32_t)((uint32_t)elapsed * POSITION_MAX / travel_time);
+    if (ch->calibration == calibration_none) {
+        if ((ch->direction > 0 && position > ch->target) || (ch->direction < 0 && position < ch->target))
+            position = ch->target;
+    }
+    if (position < 0)
+        position = 0;
+    if (position > POSITION_MAX)
+        position = POSITION_MAX;
+
+    return position;
+}
+
+static void covering_run(covering_channel_t *ch, int8_t direction, uint32_t now) {
+    ch->position = covering_position_at(ch, now);
+    ch->direction = direction;
+    ch->manual = false;
+    ch->start_time = now;
+    covering_motor(ch, direction);
+}
+
+// (Re)starts motion towards target
+static void covering_start(covering_channel_t *ch, int32_t target, uint32_t now) {
+    // Position of a running move is limited by its old target
+    int32_t position = covering_position_at(ch, now);
+    int8_t direction = (target > position) ? 1 : (target < position) ? -1 : 0;
+
+    // Keeping on in the same direction leaves start time and position
+    // alone, so the start up lag is not paid twice
+    if (direction != ch->direction || ch->manual)
+        covering_run(ch, direction, now);
+    ch->target = target;
+    if (!direction)
+        return;
+
+    uint32_t travel_time = covering_travel_time(ch, direction);
+    uint32_t duration = ch->config.lag + (uint32_t)abs(target - ch->position) * travel_time / POSITION_MAX;
+    if (target == 0 || target == POSITION_MAX) {
+        if (covering_endstop_gpio(ch, direction) != COVERING_NO_GPIO)
+            duration = ch->config.lag + travel_time * 2;   // timeout, end stop will stop it
+        else
+            duration += travel_time * HOMING_OVERRUN / 100;
+    }
+    ch->stop_time = ch->start_time + duration;
+}
+
+static void covering_stop(covering_channel_t *ch, int32_t position) {
+    covering_motor(ch, 0);
+    ch->direction = 0;
+    ch->manual = false;
+    ch->position = position;
+}
+
+static void covering_calibration_step(covering_channel_t *ch, uint8_t channel, uint32_t now, bool endstop) {
+    if (!endstop) {
+        printf("Covering %d calibration failed, end stop not reached\n", channel);
+        ch->calibration = calibration_none;
+        covering_stop(ch, covering_position_at(ch, now));
+        ch->target = ch->position;
+        return;
+    }
+
+    uint32_t travel_time = now - ch->start_time;
+    travel_time = (travel_time > ch->config.lag) ? travel_time - ch->config.lag : 1;
+
+    switch (ch->calibration) {
+        case calibration_homing:
+            ch->calibration = calibration_opening;
+            covering_stop(ch, 0);
+            covering_run(ch, 1, now);
+            break;
+        case calibration_opening:
+            ch->config.open_time = travel_time;
+            ch->calibration = calibration_closing;
+            covering_stop(ch, POSITION_MAX);
+            covering_run(ch, -1, now);
+            break;
+        default:
+            ch->config.close_time = travel_time;
+            ch->calibration = calibration_none;
+            covering_stop(ch, 0);
+            ch->target = 0;
+            printf("Covering %d calibrated: open time %ums, close time %ums\n",
+                   channel, (unsigned)ch->config.open_time, (unsigned)ch->config.close_time);
+            return;
+    }
+    ch->stop_time = now + CALIBRATION_TIMEOUT;
+}
+
+// Stops channel if it is due and returns how long (in ms) the task may sleep
+static uint32_t covering_update(covering_channel_t *ch, uint8_t channel, uint32_t now) {
+    if (!ch->direction)
+        return UINT32_MAX;
+
+    bool endstop = covering_endstop_hit(ch);
+    if (endstop || (int32_t)(now - ch->stop_time) >= 0) {
+        if (ch->manual) {
+            covering_stop(ch, ch->position);
+        } else if (ch->calibration != calibration_none) {
+            covering_calibration_step(ch, channel, now, endstop);
+        } else if (endstop) {
+            // Hitting the end re-homes the model
+            covering_stop(ch, ch->direction > 0 ? POSITION_MAX : 0);
+            ch->target = ch->position;
+        } else {
+            covering_stop(ch, ch->target);
+        }
+
+        if (!ch->direction)
+            return UINT32_MAX;
+    }
+
+    uint32_t timeout = ch->stop_time - now;
+    if (!ch->manual && timeout > REPORT_INTERVAL)
+        timeout = REPORT_INTERVAL;
+    if (covering_endstop_gpio(ch, ch->direction) != COVERING_NO_GPIO && timeout > ENDSTOP_INTERVAL)
+        timeout = ENDSTOP_INTERVAL;
+
+    return timeout;
+}
+
+static void covering_task(void *_args) {
+    covering_report_t reports[COVERING_MAX_CHANNELS];
+
+    while (true) {
+        uint32_t now = time_ms();
+        uint32_t timeout = UINT32_MAX;
+        uint8_t report_count = 0;
+
+        xSemaphoreTake(covering.lock, portMAX_DELAY);
+        for (int i = 0; i < covering.count; i++) {
+            covering_channel_t *ch = &covering.channels[i];
+
+            uint32_t channel_timeout = covering_update(ch, i, now);
+            if (channel_timeout < timeout)
+                timeout = channel_timeout;
+
+            uint8_t position = (covering_position_at(ch, now) + 50) / 100;
+            covering_state_t state = covering_state_stopped;
+            if (ch->direction && !ch->manual)
+                state = ch->direction > 0 ? covering_state_opening : covering_state_closing;
+
+            if (position != ch->reported_position || state != ch->reported_state) {
+                ch->reported_position = position;
+                ch->reported_state = state;
+                reports[report_count++] = (covering_report_t) {
+                    .channel = i, .position = position, .state = state,
+                };
+            }
+        }
+        xSemaphoreGive(covering.lock);
+
+        for (int i = 0; i < report_count; i++)
+            covering.callback(reports[i].channel, reports[i].position, reports[i].state);
+
+        TickType_t ticks = portMAX_DELAY;
+        if (timeout != UINT32_MAX) {
+            ticks = (timeout + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+            if (!ticks)
+                ticks = 1;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+int covering_init(const covering_config_t *config, uint8_t count, covering_callback_fn callback) {
+    if (count > COVERING_MAX_CHANNELS) {
+        printf("Failed to initialize coverings, too many channels\n");
+        return -1;
+    }
+
+    memset(&covering, 0, sizeof(covering));
+    covering.count = count;
+    covering.callback = callback;
+
+    for (int i = 0; i < count; i++) {
+        covering_channel_t *ch = &covering.channels[i];
+        ch->config = config[i];
+        ch->reported_state = covering_state_stopped;
+
+        gpio_enable(ch->config.open_gpio, GPIO_OUTPUT);
+        gpio_enable(ch->config.close_gpio, GPIO_OUTPUT);
+        covering_motor(ch, 0);
+
+        if (ch->config.open_endstop_gpio != COVERING_NO_GPIO)
+            gpio_enable(ch->config.open_endstop_gpio, GPIO_INPUT);
+        if (ch->config.close_endstop_gpio != COVERING_NO_GPIO)
+            gpio_enable(ch->config.close_endstop_gpio, GPIO_INPUT);
+    }
+
+    covering.lock = xSemaphoreCreateMutex();
+    if (!covering.lock) {
+        printf("Failed to create covering lock\n");
+        return -1;
+    }
+
+    if (xTaskCreate(covering_task, "Covering", COVERING_TASK_STACK, NULL,
+                    COVERING_TASK_PRIORITY, &covering.task) != pdPASS) {
+        printf("Failed to create covering task\n");
+        vSemaphoreDelete(covering.lock);
+        covering.lock = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void covering_set_target(uint8_t channel, uint8_t position) {
+    if (channel >= covering.count)
+        return;
+
+    if (position > 100)
+        position = 100;
+
+    xSemaphoreTake(covering.lock, portMAX_DELAY);
+    covering_channel_t *ch = &covering.channels[channel];
+    if (ch->calibration != calibration_none) {
+        printf("Covering %d calibration cancelled\n", channel);
+        ch->calibration = calibration_none;
+    }
+    covering_start(ch, position * 100, time_ms());
+    xSemaphoreGive(covering.lock);
+
+    xTaskNotifyGive(covering.task);
+}
+
+uint8_t covering_get_position(uint8_t channel) {
+    if (channel >= covering.count)
+        return 0;
+
+    xSemaphoreTake(covering.lock, portMAX_DELAY);
+    int32_t position = covering_position_at(&covering.channels[channel], time_ms());
+    xSemaphoreGive(covering.lock);
+
+    return (position + 50) / 100;
+}
+
+uint8_t covering_get_target(uint8_t channel) {
+    if (channel >= covering.count)
+        return 0;
+
+    return (covering.channels[channel].target + 50) / 100;
+}
+
+void covering_nudge(uint8_t channel, int8_t direction, uint16_t duration) {
+    if (channel >= covering.count || !direction)
+        return;
+
+    direction = direction > 0 ? 1 : -1;
+
+    xSemaphoreTake(covering.lock, portMAX_DELAY);
+    covering_channel_t *ch = &covering.channels[channel];
+    uint32_t now = time_ms();
+
+    if (ch->calibration == calibration_none && (!ch->direction || ch->manual)) {
+        int32_t target = ch->position + direction * 100;
+        if (ch->manual && ch->direction != direction) {
+            // Reversing a run past the limit stops it, the position stays
+            // at the limit and the next nudge moves back from there
+            covering_stop(ch, ch->position);
+        } else if (target >= 0 && target <= POSITION_MAX) {
+            covering_start(ch, target, now);
+        } else {
+            // Allow adjusting past the limit
+            if (!ch->manual) {
+                covering_run(ch, direction, now);
+                ch->manual = true;
+            }
+            ch->stop_time = now + duration;
+        }
+    }
+    xSemaphoreGive(covering.lock);
+
+    xTaskNotifyGive(covering.task);
+}
+
+int covering_calibrate(uint8_t channel) {
+    if (channel >= covering.count)
+        return -1;
+
+    covering_channel_t *ch = &covering.channels[channel];
+    if (ch->config.open_endstop_gpio == COVERING_NO_GPIO || ch->config.close_endstop_gpio == COVERING_NO_GPIO) {
+        printf("Failed to calibrate covering %d, end stops are missing\n", channel);
+        return -1;
+    }
+
+    xSemaphoreTake(covering.lock, portMAX_DELAY);
+    uint32_t now = time_ms();
+    covering_run(ch, -1, now);
+    ch->calibration = calibration_homing;
+    ch->target = 0;
+    ch->stop_time = now + CALIBRATION_TIMEOUT;
+    xSemaphoreGive(covering.lock);
+
+    xTaskNotifyGive(covering.task);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Time based position model for up to COVERING_MAX_CHANNELS motorized
+   coverings, each driven by an open and a close relay.
+
+   Position is estimated from the time the motor runs, using separate
+   speeds for each direction and the motor start up lag. All channels are
+   served by one task that sleeps until the next stop time (or position
+   report) instead of polling. Moves to fully open/closed run a bit longer
+   to push the covering against its mechanical end, which removes any
+   accumulated drift. */
+
+#ifndef COVERING_MAX_CHANNELS
+#define COVERING_MAX_CHANNELS 8
+#endif
+
+#define COVERING_NO_GPIO 0xff
+
+// Same values as HomeKit POSITION_STATE
+typedef enum {
+    covering_state_closing = 0,
+    covering_state_opening = 1,
+    covering_state_stopped = 2,
+} covering_state_t;
+
+typedef struct {
+    uint8_t open_gpio;
+    uint8_t close_gpio;
+
+    // Optional end stop switches (COVERING_NO_GPIO if not fitted),
+    // required for covering_calibrate()
+    uint8_t open_endstop_gpio;
+    uint8_t close_endstop_gpio;
+    bool endstop_value;             // level of a triggered end stop
+
+    // times in milliseconds
+    uint32_t open_time;             // full travel closed -> open
+    uint32_t close_time;            // full travel open -> closed
+    uint16_t lag;                   // motor start up before covering moves
+} covering_config_t;
+
+/* Called from the covering task when position (in percent) or state of
+   a channel changes. */
+typedef void (*covering_callback_fn)(uint8_t channel, uint8_t position, covering_state_t state);
+
+/* config is copied. Channels start stopped at fully closed. */
+int covering_init(const covering_config_t *config, uint8_t count, covering_callback_fn callback);
+
+/* Starts moving towards position (0 - 100 percent), cancels a running calibration. */
+void covering_set_target(uint8_t channel, uint8_t position);
+
+uint8_t covering_get_position(uint8_t channel);
+uint8_t covering_get_target(uint8_t channel);
+
+/* Manual control (e.g. from a remote) of an idle channel: moves the target
+   one percent in direction (1 open, -1 close). At the end of travel it runs
+   the motor for duration ms past the limit, without changing the position,
+   so the end can be adjusted. A nudge the other way stops such a run. */
+void covering_nudge(uint8_t channel, int8_t direction, uint16_t duration);
+
+/* Measures open and close times of a channel by running it between its end
+   stops. Returns a negative integer if the channel has no end stops. */
+int covering_calibrate(uint8_t channel);
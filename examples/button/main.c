@@ -9,6 +9,7 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 #include <button.h>
 
 
@@ -17,15 +18,16 @@
 #endif
 
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 
@@ -96,6 +98,10 @@ homekit_server_config_t config = {
 };
 
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
@@ -108,6 +114,5 @@ void user_init(void) {
     if (button_create(BUTTON_PIN, button_config, button_callback, NULL)) {
         printf("Failed to initialize button\n");
     }
-    homekit_server_init(&config);
 }
 
@@ -1,12 +1,23 @@
 #pragma once
 
+// Time the contact has to stay put before a change is reported, in milliseconds
+#ifndef CONTACT_SENSOR_DEBOUNCE_TIME
+#define CONTACT_SENSOR_DEBOUNCE_TIME 50
+#endif
+
 typedef enum {
     CONTACT_CLOSED,
     CONTACT_OPEN
 } contact_sensor_state_t;
 
+/**
+    Called from the contact sensor task (not from the interrupt) once the
+    contact has been stable for the debounce time and differs from the
+    previously reported state.
+*/
 typedef void (*contact_sensor_callback_fn)(uint8_t gpio_num, contact_sensor_state_t event);
 
 int contact_sensor_create(uint8_t gpio_num, contact_sensor_callback_fn callback);
-void contact_sensor_destroy(uint8_t gpio_num);
+void contact_sensor_set_debounce_time(uint8_t gpio_num, uint16_t debounce_time);
+void contact_sensor_delete(uint8_t gpio_num);
 contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num);
@@ -9,6 +9,7 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 #include "contact_sensor.h"
 
 #ifndef REED_PIN
@@ -16,15 +17,16 @@
 #endif
 
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 /**
@@ -54,7 +56,7 @@ homekit_characteristic_t door_open_characteristic = HOMEKIT_CHARACTERISTIC_(CONT
 );
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the contact sensor task once a state change has settled.
  **/
 void contact_sensor_callback(uint8_t gpio, contact_sensor_state_t state) {
     switch (state) {
@@ -110,6 +112,10 @@ homekit_server_config_t config = {
 };
 
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 9600);
 
@@ -118,7 +124,6 @@ void user_init(void) {
     if (contact_sensor_create(REED_PIN, contact_sensor_callback)) {
         printf("Failed to initialize door\n");
     }
-    homekit_server_init(&config);
 
     homekit_characteristic_notify(&door_open_characteristic, door_state_getter());
 }
@@ -12,20 +12,27 @@
 #include <homekit/characteristics.h>
 
 #include "wifi.h"
+#include <wifi_manager.h>
+#include <accessory_arena.h>
+#include <health_metrics.h>
 
 
 #define MAX_SERVICES 20
 
+#define HEALTH_SAMPLE_PERIOD 5000     // free heap and stacks are sampled this often (ms)
+#define HEALTH_REPORT_PERIOD 60000    // and printed to UART this often (ms)
+
+
+void on_wifi_ready();
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 
@@ -34,7 +41,32 @@ const int led_gpio = 2;
 const uint8_t relay_gpios[] = {
   12, 5, 14, 13
 };
-const size_t relay_count = sizeof(relay_gpios) / sizeof(*relay_gpios);
+#define RELAY_COUNT (sizeof(relay_gpios) / sizeof(*relay_gpios))
+const size_t relay_count = RELAY_COUNT;
+
+// Accessory database never changes after boot, so it is built in one
+// static block sized for the relays above instead of many small mallocs.
+#define INFO_SERVICE_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_service_t)) + \
+    ACCESSORY_ARENA_SIZEOF(7 * sizeof(homekit_characteristic_t*)) + \
+    6 * ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof("Relays-XXXXXX")))
+
+#define RELAY_SERVICE_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_service_t)) + \
+    ACCESSORY_ARENA_SIZEOF(3 * sizeof(homekit_characteristic_t*)) + \
+    2 * ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_change_callback_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof("Relay 255")))
+
+#define ACCESSORY_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_accessory_t)) + \
+    ACCESSORY_ARENA_SIZEOF((RELAY_COUNT + 3) * sizeof(homekit_service_t*)) + \
+    INFO_SERVICE_ARENA_SIZE + \
+    RELAY_COUNT * RELAY_SERVICE_ARENA_SIZE)
+
+static void *accessory_arena_buffer[ACCESSORY_ARENA_SIZE / sizeof(void*)];
+accessory_arena_t arena;
 
 
 void relay_write(int relay, bool on) {
@@ -81,6 +113,8 @@ void lamp_identify(homekit_value_t _value) {
 }
 
 void relay_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    health_metrics_count(health_metrics_setter_calls);
+
     uint8_t *gpio = context;
     relay_write(*gpio, value.bool_value);
 }
@@ -102,33 +136,31 @@ void init_accessory() {
     uint8_t macaddr[6];
     sdk_wifi_get_macaddr(STATION_IF, macaddr);
 
-    int name_len = snprintf(NULL, 0, "Relays-%02X%02X%02X",
-                            macaddr[3], macaddr[4], macaddr[5]);
-    char *name_value = malloc(name_len+1);
-    snprintf(name_value, name_len+1, "Relays-%02X%02X%02X",
-             macaddr[3], macaddr[4], macaddr[5]);
+    accessory_arena_init(&arena, accessory_arena_buffer, sizeof(accessory_arena_buffer));
+
+    char *name_value = accessory_arena_printf(&arena, "Relays-%02X%02X%02X",
+                                              macaddr[3], macaddr[4], macaddr[5]);
 
     homekit_service_t* services[MAX_SERVICES + 1];
     homekit_service_t** s = services;
 
-    *(s++) = NEW_HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
-        NEW_HOMEKIT_CHARACTERISTIC(NAME, name_value),
-        NEW_HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"),
-        NEW_HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"),
-        NEW_HOMEKIT_CHARACTERISTIC(MODEL, "Relays"),
-        NEW_HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
-        NEW_HOMEKIT_CHARACTERISTIC(IDENTIFY, lamp_identify),
+    *(s++) = ARENA_HOMEKIT_SERVICE(&arena, ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, NAME, name_value),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, MANUFACTURER, "HaPK"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, SERIAL_NUMBER, "0"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, MODEL, "Relays"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, FIRMWARE_REVISION, "0.1"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, IDENTIFY, lamp_identify),
         NULL
     });
 
     for (int i=0; i < relay_count; i++) {
-        int relay_name_len = snprintf(NULL, 0, "Relay %d", i + 1);
-        char *relay_name_value = malloc(relay_name_len+1);
-        snprintf(relay_name_value, relay_name_len+1, "Relay %d", i + 1);
+        char *relay_name_value = accessory_arena_printf(&arena, "Relay %d", i + 1);
 
-        *(s++) = NEW_HOMEKIT_SERVICE(LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
-            NEW_HOMEKIT_CHARACTERISTIC(NAME, relay_name_value),
-            NEW_HOMEKIT_CHARACTERISTIC(
+        *(s++) = ARENA_HOMEKIT_SERVICE(&arena, LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
+            ARENA_HOMEKIT_CHARACTERISTIC(&arena, NAME, relay_name_value),
+            ARENA_HOMEKIT_CHARACTERISTIC(
+                &arena,
                 ON, true,
                 .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
                     relay_callback, .context=(void*)&relay_gpios[i]
@@ -138,19 +170,24 @@ void init_accessory() {
         });
     }
 
+    *(s++) = &health_metrics_service;
     *(s++) = NULL;
 
-    accessories[0] = NEW_HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other, .services=services);
+    accessories[0] = ARENA_HOMEKIT_ACCESSORY(&arena, .category=homekit_accessory_category_other, .services=services);
     accessories[1] = NULL;
+
+    health_metrics_watch(accessories);
+
+    accessory_arena_report(&arena);
 }
 
 void user_init(void) {
     uart_set_baud(0, 115200);
 
+    health_metrics_init(HEALTH_SAMPLE_PERIOD, HEALTH_REPORT_PERIOD);
     init_accessory();
 
     gpio_init();
 
     wifi_init();
-    on_wifi_ready();
 }
@@ -1 +1 @@
-COMPONENT_DEPENDS = homekit
+COMPONENT_DEPENDS = homekit accessory_arena
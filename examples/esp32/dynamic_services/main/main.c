@@ -12,6 +12,7 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <accessory_arena.h>
 
 
 #define MAX_SERVICES 20
@@ -65,7 +66,32 @@ const int led_gpio = 2;
 const uint8_t relay_gpios[] = {
   12, 5, 14, 13
 };
-const size_t relay_count = sizeof(relay_gpios) / sizeof(*relay_gpios);
+#define RELAY_COUNT (sizeof(relay_gpios) / sizeof(*relay_gpios))
+const size_t relay_count = RELAY_COUNT;
+
+// Accessory database never changes after boot, so it is built in one
+// static block sized for the relays above instead of many small mallocs.
+#define INFO_SERVICE_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_service_t)) + \
+    ACCESSORY_ARENA_SIZEOF(7 * sizeof(homekit_characteristic_t*)) + \
+    6 * ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof("Relays-XXXXXX")))
+
+#define RELAY_SERVICE_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_service_t)) + \
+    ACCESSORY_ARENA_SIZEOF(3 * sizeof(homekit_characteristic_t*)) + \
+    2 * ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_characteristic_change_callback_t)) + \
+    ACCESSORY_ARENA_SIZEOF(sizeof("Relay 255")))
+
+#define ACCESSORY_ARENA_SIZE ( \
+    ACCESSORY_ARENA_SIZEOF(sizeof(homekit_accessory_t)) + \
+    ACCESSORY_ARENA_SIZEOF((RELAY_COUNT + 2) * sizeof(homekit_service_t*)) + \
+    INFO_SERVICE_ARENA_SIZE + \
+    RELAY_COUNT * RELAY_SERVICE_ARENA_SIZE)
+
+static void *accessory_arena_buffer[ACCESSORY_ARENA_SIZE / sizeof(void*)];
+accessory_arena_t arena;
 
 
 void relay_write(int relay, bool on) {
@@ -123,33 +149,31 @@ void init_accessory() {
     uint8_t macaddr[6];
     esp_read_mac(macaddr, ESP_MAC_WIFI_STA);
 
-    int name_len = snprintf(NULL, 0, "Relays-%02X%02X%02X",
-                            macaddr[3], macaddr[4], macaddr[5]);
-    char *name_value = malloc(name_len+1);
-    snprintf(name_value, name_len+1, "Relays-%02X%02X%02X",
-             macaddr[3], macaddr[4], macaddr[5]);
+    accessory_arena_init(&arena, accessory_arena_buffer, sizeof(accessory_arena_buffer));
+
+    char *name_value = accessory_arena_printf(&arena, "Relays-%02X%02X%02X",
+                                              macaddr[3], macaddr[4], macaddr[5]);
 
     homekit_service_t* services[MAX_SERVICES + 1];
     homekit_service_t** s = services;
 
-    *(s++) = NEW_HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
-        NEW_HOMEKIT_CHARACTERISTIC(NAME, name_value),
-        NEW_HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"),
-        NEW_HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"),
-        NEW_HOMEKIT_CHARACTERISTIC(MODEL, "Relays"),
-        NEW_HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
-        NEW_HOMEKIT_CHARACTERISTIC(IDENTIFY, identify),
+    *(s++) = ARENA_HOMEKIT_SERVICE(&arena, ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, NAME, name_value),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, MANUFACTURER, "HaPK"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, SERIAL_NUMBER, "0"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, MODEL, "Relays"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, FIRMWARE_REVISION, "0.1"),
+        ARENA_HOMEKIT_CHARACTERISTIC(&arena, IDENTIFY, identify),
         NULL
     });
 
     for (int i=0; i < relay_count; i++) {
-        int relay_name_len = snprintf(NULL, 0, "Relay %d", i + 1);
-        char *relay_name_value = malloc(name_len+1);
-        snprintf(relay_name_value, relay_name_len+1, "Relay %d", i + 1);
+        char *relay_name_value = accessory_arena_printf(&arena, "Relay %d", i + 1);
 
-        *(s++) = NEW_HOMEKIT_SERVICE(LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
-            NEW_HOMEKIT_CHARACTERISTIC(NAME, relay_name_value),
-            NEW_HOMEKIT_CHARACTERISTIC(
+        *(s++) = ARENA_HOMEKIT_SERVICE(&arena, LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
+            ARENA_HOMEKIT_CHARACTERISTIC(&arena, NAME, relay_name_value),
+            ARENA_HOMEKIT_CHARACTERISTIC(
+                &arena,
                 ON, true,
                 .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
                     relay_callback, .context=(void*)&relay_gpios[i]
@@ -161,8 +185,10 @@ void init_accessory() {
 
     *(s++) = NULL;
 
-    accessories[0] = NEW_HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other, .services=services);
+    accessories[0] = ARENA_HOMEKIT_ACCESSORY(&arena, .category=homekit_accessory_category_other, .services=services);
     accessories[1] = NULL;
+
+    accessory_arena_report(&arena);
 }
 
 void on_wifi_ready() {
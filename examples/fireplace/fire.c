@@ -0,0 +1,133 @@
+#include <string.h>
+#include "fire.h"
+
+static const uint32_t heat_palette[256] = {
+    0x000000, 0x030000, 0x060000, 0x090000, 0x0c0000, 0x0f0000, 0x130000, 0x160000,
+    0x190000, 0x1c0000, 0x1f0000, 0x230000, 0x260000, 0x290000, 0x2c0000, 0x2f0000,
+    0x330000, 0x350000, 0x380000, 0x3c0000, 0x3f0000, 0x410000, 0x450000, 0x480000,
+    0x4c0000, 0x4f0000, 0x510000, 0x550000, 0x580000, 0x5b0000, 0x5f0000, 0x610000,
+    0x660000, 0x680000, 0x6b0000, 0x6e0000, 0x720000, 0x740000, 0x780000, 0x7a0000,
+    0x7e0000, 0x820000, 0x840000, 0x880000, 0x8b0000, 0x8e0000, 0x910000, 0x940000,
+    0x990000, 0x9a0000, 0x9e0000, 0xa10000, 0xa50000, 0xa70000, 0xab0000, 0xae0000,
+    0xb10000, 0xb40000, 0xb70000, 0xbb0000, 0xbe0000, 0xc10000, 0xc40000, 0xc70000,
+    0xcc0000, 0xcd0000, 0xd00000, 0xd30000, 0xd70000, 0xda0000, 0xdd0000, 0xe00000,
+    0xe40000, 0xe70000, 0xea0000, 0xed0000, 0xf10000, 0xf40000, 0xf70000, 0xfa0000,
+    0xff0000, 0xfd0300, 0xfd0600, 0xfd0900, 0xfd0c00, 0xfd0f00, 0xfd1300, 0xfd1600,
+    0xfd1900, 0xfd1c00, 0xfd1f00, 0xfd2300, 0xfd2600, 0xfd2900, 0xfd2c00, 0xfd2f00,
+    0xff3300, 0xfd3500, 0xfd3800, 0xfd3c00, 0xfd3f00, 0xfd4100, 0xfd4500, 0xfd4800,
+    0xfd4c00, 0xfd4f00, 0xfd5100, 0xfd5500, 0xfd5800, 0xfd5b00, 0xfd5f00, 0xfd6100,
+    0xff6600, 0xfd6800, 0xfd6b00, 0xfd6e00, 0xfd7200, 0xfd7400, 0xfd7800, 0xfd7a00,
+    0xfd7e00, 0xfd8200, 0xfd8400, 0xfd8800, 0xfd8b00, 0xfd8e00, 0xfd9100, 0xfd9400,
+    0xff9900, 0xfd9a00, 0xfd9e00, 0xfda100, 0xfda500, 0xfda700, 0xfdab00, 0xfdae00,
+    0xfdb100, 0xfdb400, 0xfdb700, 0xfdbb00, 0xfdbe00, 0xfdc100, 0xfdc400, 0xfdc700,
+    0xffcc00, 0xfdcd00, 0xfdd000, 0xfdd300, 0xfdd700, 0xfdda00, 0xfddd00, 0xfde000,
+    0xfde400, 0xfde700, 0xfdea00, 0xfded00, 0xfdf100, 0xfdf400, 0xfdf700, 0xfdfa00,
+    0xffff00, 0xfdfd03, 0xfdfd06, 0xfdfd09, 0xfdfd0c, 0xfdfd0f, 0xfdfd13, 0xfdfd16,
+    0xfdfd19, 0xfdfd1c, 0xfdfd1f, 0xfdfd23, 0xfdfd26, 0xfdfd29, 0xfdfd2c, 0xfdfd2f,
+    0xffff33, 0xfdfd35, 0xfdfd38, 0xfdfd3c, 0xfdfd3f, 0xfdfd41, 0xfdfd45, 0xfdfd48,
+    0xfdfd4c, 0xfdfd4f, 0xfdfd51, 0xfdfd55, 0xfdfd58, 0xfdfd5b, 0xfdfd5f, 0xfdfd61,
+    0xffff66, 0xfdfd68, 0xfdfd6b, 0xfdfd6e, 0xfdfd72, 0xfdfd74, 0xfdfd78, 0xfdfd7a,
+    0xfdfd7e, 0xfdfd82, 0xfdfd84, 0xfdfd88, 0xfdfd8b, 0xfdfd8e, 0xfdfd91, 0xfdfd94,
+    0xffff99, 0xfdfd9a, 0xfdfd9e, 0xfdfda1, 0xfdfda5, 0xfdfda7, 0xfdfdab, 0xfdfdae,
+    0xfdfdb1, 0xfdfdb4, 0xfdfdb7, 0xfdfdbb, 0xfdfdbe, 0xfdfdc1, 0xfdfdc4, 0xfdfdc7,
+    0xffffcc, 0xfdfdcd, 0xfdfdd0, 0xfdfdd3, 0xfdfdd7, 0xfdfdda, 0xfdfddd, 0xfdfde0,
+    0xfdfde4, 0xfdfde7, 0xfdfdea, 0xfdfded, 0xfdfdf1, 0xfdfdf4, 0xfdfdf7, 0xfdfdfa,
+    0xffffff, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd,
+    0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd, 0xfdfdfd,
+};
+
+static inline uint32_t fire_rand(fire_t *fire) {
+    // xorshift32
+    uint32_t x = fire->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fire->rand_state = x;
+    return x;
+}
+
+// Random number in [0, n), n <= 65535
+static inline uint32_t fire_rand_range(fire_t *fire, uint32_t n) {
+    return ((fire_rand(fire) & 0xffff) * n) >> 16;
+}
+
+void fire_init(fire_t *fire, uint8_t width, uint8_t height, uint16_t *heat, uint8_t cooling) {
+    fire->width = width;
+    fire->height = height;
+    fire->heat = heat;
+
+    // Palette index used to be (stack heat) * 2 / height
+    fire->unit = (512 << 8) / height;
+    fire->cooling = (cooling * fire->unit) >> 8;
+    fire->rand_state = 0x2545f491;
+
+    memset(heat, 0, width * height * sizeof(uint16_t));
+}
+
+void fire_update(fire_t *fire, uint8_t intensity, uint32_t seed) {
+    const uint8_t width = fire->width;
+    const uint8_t height = fire->height;
+    uint16_t *heat = fire->heat;
+
+    fire->rand_state ^= seed;
+    if (!fire->rand_state)
+        fire->rand_state = 0x2545f491;
+
+    uint32_t hot = ((256 * intensity / 100) * fire->unit) >> 8;
+    uint32_t maxhot = 256 * intensity / 100 * 512;
+    if (maxhot > 0xffff)
+        maxhot = 0xffff;
+    if (hot > maxhot)
+        hot = maxhot;
+
+    // 1. Cool all the sparks
+    for (int i = 0; i < width * height; i++) {
+        uint32_t cooling = fire_rand_range(fire, fire->cooling);
+        heat[i] = (heat[i] < cooling) ? 0 : heat[i] - cooling;
+    }
+
+    // 2. Light new sparks at the bottom
+    for (int x = 0; x < width; x++) {
+        if (heat[x] < hot) {
+            heat[x] = hot + fire_rand_range(fire, maxhot - hot);
+        }
+    }
+
+    // 3. Heat drifts up and diffuses a little. Rows are updated top down,
+    // so every cell reads the row below as it was before this step and
+    // diffusion is symmetric. (The old column-major loop read the already
+    // updated left neighbours, which skewed the flames to the right.)
+    for (int y = height - 1; y > 0; y--) {
+        uint16_t *row = &heat[y * width];
+        const uint16_t *below = &heat[(y - 1) * width];
+
+        for (int x = 0; x < width; x++) {
+            uint32_t sum = row[x] + below[x];
+            if (x > 0)
+                sum += below[x - 1];
+            if (x < width - 1)
+                sum += below[x + 1];
+
+            // sum / 6
+            row[x] = (sum * 10923) >> 16;
+        }
+    }
+}
+
+void fire_render(const fire_t *fire, ws2812_pixel_t *pixels) {
+    const uint8_t width = fire->width;
+    const uint8_t height = fire->height;
+    const uint16_t *heat = fire->heat;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t color = heat_palette[heat[y * width + x] >> 8];
+
+            if (x % 2 == 0) {
+                pixels[(x * height) + y].color = color;
+            } else {
+                pixels[(x * height) + height - y - 1].color = color;
+            }
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/* Fire simulation on a width x height grid of 16-bit heat cells stored
+   row-major, row 0 being the bottom (where sparks are born).
+   Cell value >> 8 is the index into 256 color heat palette. */
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    uint16_t *heat;
+
+    uint32_t unit;          // stack heat unit to cell value, 8.8 fixed point
+    uint16_t cooling;       // max cooling per frame, in cell units
+    uint32_t rand_state;
+} fire_t;
+
+/* heat should point to width*height cells */
+void fire_init(fire_t *fire, uint8_t width, uint8_t height, uint16_t *heat, uint8_t cooling);
+
+/* Advances simulation by one frame. Intensity is in percent, seed is mixed
+   into internal PRNG (e.g. a value from hwrand()) once per frame. */
+void fire_update(fire_t *fire, uint8_t intensity, uint32_t seed);
+
+/* Renders heat grid to a strip laid out in columns going up and down
+   alternately (see fireplace.c) */
+void fire_render(const fire_t *fire, ws2812_pixel_t *pixels);
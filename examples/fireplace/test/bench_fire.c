@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "fire.h"
+
+// Frames per second of the fire kernel (fire_update() plus fire_render())
+// on the host for a few grid sizes. The host is much faster than the
+// ESP8266, so compare sizes and revisions of fire.c with it rather than
+// reading the numbers as device frame rates.
+
+#define MAX_CELLS (32 * 64)
+#define BENCH_TIME_NS 500000000ull
+
+static const struct {
+    uint8_t width;
+    uint8_t height;
+} sizes[] = {
+    { 6, 10 },
+    { 16, 32 },
+    { 32, 64 },
+};
+
+static uint64_t time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main() {
+    static uint16_t heat[MAX_CELLS];
+    static ws2812_pixel_t pixels[MAX_CELLS];
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        fire_t fire;
+        fire_init(&fire, sizes[i].width, sizes[i].height, heat, 55);
+
+        uint32_t frames = 0;
+        uint64_t start = time_ns(), elapsed;
+        do {
+            // Enough frames between clock reads to not measure the clock
+            for (int j = 0; j < 64; j++, frames++) {
+                fire_update(&fire, 50, frames * 2654435761u);
+                fire_render(&fire, pixels);
+            }
+            elapsed = time_ns() - start;
+        } while (elapsed < BENCH_TIME_NS);
+
+        double fps = frames * 1e9 / elapsed;
+        int cells = sizes[i].width * sizes[i].height;
+        printf("%2ux%-2u %10.0f fps %8.1f ns per cell\n", sizes[i].width, sizes[i].height,
+               fps, 1e9 / fps / cells);
+    }
+
+    return 0;
+}
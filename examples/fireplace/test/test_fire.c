@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "fire.h"
+
+// Golden output test of the fire kernel. A fixed seed sequence makes the
+// simulation deterministic, so the heat grid and the rendered pixels after
+// a number of frames are pinned by their hashes. If a change to fire.c is
+// meant to change the output, check it on a strip and update the hashes.
+
+#define FRAMES 200
+#define MAX_CELLS (16 * 32)
+
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    uint8_t intensity;
+    uint32_t heat_hash;
+    uint32_t pixel_hash;
+} golden_t;
+
+static const golden_t golden[] = {
+    {  6, 10,  50, 0x5c40560a, 0x5f8df8ad },
+    {  6, 10, 100, 0xab8cc889, 0x1a363e52 },
+    { 16, 32,  50, 0x2c5c2935, 0x5cd0905a },
+};
+
+static int failures = 0;
+
+static uint32_t fnv1a(const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void test_golden(const golden_t *g) {
+    uint16_t heat[MAX_CELLS];
+    ws2812_pixel_t pixels[MAX_CELLS];
+    fire_t fire;
+
+    fire_init(&fire, g->width, g->height, heat, 55);
+    for (uint32_t frame = 0; frame < FRAMES; frame++)
+        fire_update(&fire, g->intensity, frame * 2654435761u);
+    fire_render(&fire, pixels);
+
+    int cells = g->width * g->height;
+    uint32_t heat_hash = fnv1a(heat, cells * sizeof(*heat));
+    uint32_t pixel_hash = fnv1a(pixels, cells * sizeof(*pixels));
+
+    printf("%2ux%-2u %3u%%: heat 0x%08x pixels 0x%08x", g->width, g->height, g->intensity,
+           heat_hash, pixel_hash);
+    if (heat_hash != g->heat_hash || pixel_hash != g->pixel_hash) {
+        printf("  expected heat 0x%08x pixels 0x%08x", g->heat_hash, g->pixel_hash);
+        failures++;
+    }
+    printf("\n");
+}
+
+// With no cooling and no sparks a frame is pure diffusion. Every cell must
+// become the average of itself and the three cells below it as they were
+// before the frame (edges count the missing neighbour as 0), divided by 6.
+static void test_diffusion() {
+    const uint8_t width = 7, height = 5;
+    uint16_t heat[7 * 5], before[7 * 5];
+    fire_t fire;
+
+    fire_init(&fire, width, height, heat, 0);
+    for (int i = 0; i < width * height; i++)
+        heat[i] = (i * 7919) % 60000;
+    memcpy(before, heat, sizeof(heat));
+
+    fire_update(&fire, 0, 0);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t expected = before[y * width + x];
+            if (y > 0) {
+                uint32_t sum = before[y * width + x] + before[(y - 1) * width + x];
+                if (x > 0)
+                    sum += before[(y - 1) * width + x - 1];
+                if (x < width - 1)
+                    sum += before[(y - 1) * width + x + 1];
+                expected = sum / 6;
+            }
+
+            int diff = (int)heat[y * width + x] - (int)expected;
+            // Reciprocal multiply may be off by one
+            if (diff < -1 || diff > 1) {
+                printf("diffusion: cell %d,%d is %u, expected %u\n", x, y, heat[y * width + x], expected);
+                failures++;
+            }
+        }
+    }
+}
+
+int main() {
+    test_diffusion();
+
+    for (size_t i = 0; i < sizeof(golden) / sizeof(*golden); i++)
+        test_golden(&golden[i]);
+
+    if (failures) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host stand-in for the esp-open-rtos extras header, only the pixel type
+// is needed by the fire kernel.
+
+#include <stdint.h>
+
+typedef union {
+    struct {
+        uint8_t blue;
+        uint8_t green;
+        uint8_t red;
+        uint8_t white;
+    };
+    uint32_t color;
+} ws2812_pixel_t;
@@ -1,27 +1,47 @@
 #include <string.h>
 #include <etstimer.h>
 #include <esplibs/libmain.h>
+#include <FreeRTOS.h>
+#include <task.h>
 #include "contact_sensor.h"
 
+// GPIO0 - GPIO16
+#define CONTACT_SENSOR_MAX_GPIO 17
+// Must be a power of two
+#define CONTACT_SENSOR_QUEUE_SIZE 32
+
+typedef struct {
+    uint32_t time;
+    uint8_t gpio_num;
+} contact_sensor_edge_t;
 
 typedef struct _contact_sensor {
     uint8_t gpio_num;
     contact_sensor_callback_fn callback;
 
-    struct _contact_sensor *next;
+    uint16_t debounce_time;
+
+    // Last state delivered to the callback
+    contact_sensor_state_t state;
+    bool pending;
+    uint32_t last_edge_time;
+
+    struct _contact_sensor *next_deleted;
 } contact_sensor_t;
 
 
-contact_sensor_t *sensors = NULL;
+static contact_sensor_t *sensors[CONTACT_SENSOR_MAX_GPIO];
+static TaskHandle_t sensor_task_handle = NULL;
 
+// Deleted sensors are freed by the task, which may still be using them
+static contact_sensor_t *deleted_sensors = NULL;
 
-static contact_sensor_t *contact_sensor_find_by_gpio(const uint8_t gpio_num) {
-    contact_sensor_t *sensor = sensors;
-    while (sensor && sensor->gpio_num != gpio_num)
-        sensor = sensor->next;
+// Single producer (ISR) / single consumer (task) ring, no locking needed.
+static contact_sensor_edge_t edges[CONTACT_SENSOR_QUEUE_SIZE];
+static volatile uint8_t edges_head = 0;
+static volatile uint8_t edges_tail = 0;
+static volatile uint16_t edges_dropped = 0;
 
-    return sensor;
-}
 
 contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num) {
     return gpio_read(gpio_num);
@@ -29,57 +49,160 @@ contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num) {
 
 
 void contact_sensor_intr_callback(uint8_t gpio) {
-    contact_sensor_t *sensor = contact_sensor_find_by_gpio(gpio);
-    if (!sensor)
+    if (gpio >= CONTACT_SENSOR_MAX_GPIO || !sensors[gpio])
         return;
 
-    sensor->callback(sensor->gpio_num, contact_sensor_state_get(sensor->gpio_num));
+    uint8_t head = edges_head;
+    if ((uint8_t)(head - edges_tail) < CONTACT_SENSOR_QUEUE_SIZE) {
+        contact_sensor_edge_t *edge = &edges[head & (CONTACT_SENSOR_QUEUE_SIZE - 1)];
+        edge->time = xTaskGetTickCountFromISR();
+        edge->gpio_num = gpio;
+        edges_head = head + 1;
+    } else {
+        edges_dropped++;
+    }
+
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(sensor_task_handle, &task_woken);
+    portEND_SWITCHING_ISR(task_woken);
+}
+
+
+static void contact_sensor_free_deleted() {
+    taskENTER_CRITICAL();
+    contact_sensor_t *sensor = deleted_sensors;
+    deleted_sensors = NULL;
+    taskEXIT_CRITICAL();
+
+    while (sensor) {
+        contact_sensor_t *next = sensor->next_deleted;
+        free(sensor);
+        sensor = next;
+    }
+}
+
+
+static void contact_sensor_drain() {
+    static uint16_t dropped = 0;
+
+    while (edges_tail != edges_head) {
+        contact_sensor_edge_t *edge = &edges[edges_tail & (CONTACT_SENSOR_QUEUE_SIZE - 1)];
+        contact_sensor_t *sensor = sensors[edge->gpio_num];
+        if (sensor) {
+            sensor->pending = true;
+            sensor->last_edge_time = edge->time;
+        }
+        edges_tail++;
+    }
+
+    if (dropped != edges_dropped) {
+        // Lost track of some edges, restart the stable window of every
+        // sensor and let the final read decide.
+        dropped = edges_dropped;
+        TickType_t now = xTaskGetTickCount();
+        for (int i = 0; i < CONTACT_SENSOR_MAX_GPIO; i++) {
+            if (sensors[i]) {
+                sensors[i]->pending = true;
+                sensors[i]->last_edge_time = now;
+            }
+        }
+    }
+}
+
+
+static void contact_sensor_task(void *_args) {
+    TickType_t timeout = portMAX_DELAY;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, timeout);
+
+        contact_sensor_free_deleted();
+        contact_sensor_drain();
+
+        // Read after draining, edges stamped meanwhile must not be in the future
+        TickType_t now = xTaskGetTickCount();
+
+        timeout = portMAX_DELAY;
+        for (int i = 0; i < CONTACT_SENSOR_MAX_GPIO; i++) {
+            contact_sensor_t *sensor = sensors[i];
+            if (!sensor || !sensor->pending)
+                continue;
+
+            int32_t stable = (int32_t)(now - sensor->last_edge_time);
+            int32_t window = pdMS_TO_TICKS(sensor->debounce_time);
+            if (stable < window) {
+                // Still bouncing, come back when the window closes.
+                if ((TickType_t)(window - stable) < timeout)
+                    timeout = window - stable;
+                continue;
+            }
+
+            sensor->pending = false;
+
+            contact_sensor_state_t state = contact_sensor_state_get(sensor->gpio_num);
+            if (state != sensor->state) {
+                sensor->state = state;
+                sensor->callback(sensor->gpio_num, state);
+            }
+        }
+    }
 }
 
 
 int contact_sensor_create(const uint8_t gpio_num, contact_sensor_callback_fn callback) {
-    contact_sensor_t *sensor = contact_sensor_find_by_gpio(gpio_num);
-    if (sensor)
+    if (gpio_num >= CONTACT_SENSOR_MAX_GPIO || sensors[gpio_num])
+        return -1;
+
+    if (!sensor_task_handle) {
+        if (xTaskCreate(contact_sensor_task, "Contact sensor", 512, NULL, 2, &sensor_task_handle) != pdPASS) {
+            sensor_task_handle = NULL;
+            return -1;
+        }
+    }
+
+    contact_sensor_t *sensor = malloc(sizeof(contact_sensor_t));
+    if (!sensor)
         return -1;
 
-    sensor = malloc(sizeof(contact_sensor_t));
     memset(sensor, 0, sizeof(*sensor));
     sensor->gpio_num = gpio_num;
     sensor->callback = callback;
-
-    sensor->next = sensors;
-    sensors = sensor;
+    sensor->debounce_time = CONTACT_SENSOR_DEBOUNCE_TIME;
 
     gpio_set_pullup(sensor->gpio_num, true, true);
+    sensor->state = contact_sensor_state_get(sensor->gpio_num);
+
+    sensors[gpio_num] = sensor;
+
     gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, contact_sensor_intr_callback);
 
     return 0;
 }
 
 
+void contact_sensor_set_debounce_time(const uint8_t gpio_num, uint16_t debounce_time) {
+    if (gpio_num >= CONTACT_SENSOR_MAX_GPIO || !sensors[gpio_num])
+        return;
+
+    sensors[gpio_num]->debounce_time = debounce_time;
+}
+
+
 void contact_sensor_delete(const uint8_t gpio_num) {
-    if (!sensors)
+    if (gpio_num >= CONTACT_SENSOR_MAX_GPIO)
         return;
 
-    contact_sensor_t *sensor = NULL;
-    if (sensors->gpio_num == gpio_num) {
-        // Skip first element:
-        sensor = sensors;
-        sensors = sensors->next;
-    } else {
-        contact_sensor_t *b = sensors;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                // Unlink middle element:
-                sensor = b->next;
-                b->next = b->next->next;
-                break;
-            }
-        }
-    }
+    contact_sensor_t *sensor = sensors[gpio_num];
+    if (!sensor)
+        return;
 
-    if (sensor) {
-        gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
-    }
-}
+    gpio_set_interrupt(sensor->gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+
+    taskENTER_CRITICAL();
+    sensors[gpio_num] = NULL;
+    sensor->next_deleted = deleted_sensors;
+    deleted_sensors = sensor;
+    taskEXIT_CRITICAL();
 
+    xTaskNotifyGive(sensor_task_handle);
+}
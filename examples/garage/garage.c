@@ -5,6 +5,7 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <queue.h>
 #include <assert.h>
 #include <etstimer.h>
 #include <esplibs/libmain.h>
@@ -12,7 +13,13 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
+
+#define DLOG_MODULE "garage"
+#include <deferred_log.h>
+
 #include "contact_sensor.h"
+#include "relay_actor.h"
 
 // Possible values for characteristic CURRENT_DOOR_STATE:
 #define HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN 0
@@ -27,6 +34,8 @@
 #define HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_UNKNOWN 255
 
 #define OPEN_CLOSE_DURATION 22
+#define RELAY_PULSE_TIME 400  // in milliseconds
+#define REED_DEBOUNCE_TIME 200  // in milliseconds, the reed contact chatters
 
 const char *state_description(uint8_t state) {
     const char* description = "unknown";
@@ -41,15 +50,16 @@ const char *state_description(uint8_t state) {
     return description;
 }
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 // Declare functions:
@@ -99,36 +109,31 @@ homekit_accessory_t *accessories[] = {
 
 bool relay_on = false;
 uint8_t current_door_state = HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_UNKNOWN;
-ETSTimer update_timer; // used for delayed updating from contact sensor
+uint8_t target_door_state = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_UNKNOWN;
+ETSTimer update_timer; // fires when the door should have finished moving
+QueueHandle_t door_queue; // HomeKit, sensor and timer events, handled by the door task
 
+#define DOOR_QUEUE_SIZE 8
 
+typedef enum {
+    door_event_target_open,
+    door_event_target_closed,
+    door_event_sensor_closed,
+    door_event_sensor_not_closed,
+    door_event_travel_timeout,
+} door_event_t;
 
-void relay_write(bool on) {
-    gpio_write(RELAY_PIN, on ? 0 : 1);
-}
 
 void relay_init() {
-    gpio_enable(RELAY_PIN, GPIO_OUTPUT);
-    relay_write(relay_on);
+    relay_actor_create(RELAY_PIN, false);
 }
 
-void identify_task(void *_args) {
+void identify(homekit_value_t _value) {
     // 1. move the door, 2. stop it, 3. move it back:
-    for (int i=0; i<3; i++) {
-            relay_write(true);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            relay_write(false);
-            vTaskDelay(3500 / portTICK_PERIOD_MS);
-    }
-
-    relay_write(false);
+    static const uint16_t sequence[] = { 500, 3500, 500, 3500, 500 };
 
-    vTaskDelete(NULL);
-}
-
-void identify(homekit_value_t _value) {
     printf("GDO identify\n");
-    xTaskCreate(identify_task, "GDO identify", 128, NULL, 2, NULL);
+    relay_actor_sequence(RELAY_PIN, sequence, sizeof(sequence) / sizeof(*sequence));
 }
 
 homekit_value_t relay_on_get() {
@@ -137,153 +142,210 @@ homekit_value_t relay_on_get() {
 
 void relay_on_set(homekit_value_t value) {
     if (value.format != homekit_format_bool) {
-        printf("Invalid value format: %d\n", value.format);
+        DLOG_WARN("Invalid value format: %d\n", value.format);
         return;
     }
 
     relay_on = value.bool_value;
-    relay_write(relay_on);
+    relay_actor_set(RELAY_PIN, relay_on);
 }
 
 homekit_value_t gdo_obstruction_get() {
     return HOMEKIT_BOOL(false);
 }
 
-void gdo_current_state_notify_homekit() {
-
-    homekit_value_t new_value = HOMEKIT_UINT8(current_door_state);
-    printf("Notifying homekit that current door state is now '%s'\n", state_description(current_door_state));
-
-    // Find the current door state characteristic c:
+homekit_characteristic_t *gdo_characteristic(uint8_t index) {
+    // Find the characteristic in the garage door opener service:
     homekit_accessory_t *accessory = accessories[0];
     homekit_service_t *service = accessory->services[1];
-    homekit_characteristic_t *c = service->characteristics[1];
+    homekit_characteristic_t *c = service->characteristics[index];
 
     assert(c);
 
-    printf("Notifying changed '%s'\n", c->description);
-    homekit_characteristic_notify(c, new_value);
+    return c;
 }
 
-void gdo_target_state_notify_homekit() {
+void gdo_current_state_notify_homekit() {
 
-    homekit_value_t new_value = gdo_target_state_get();
-    printf("Notifying homekit that target door state is now '%s'\n", state_description(new_value.int_value));
+    homekit_value_t new_value = HOMEKIT_UINT8(current_door_state);
+    DLOG_INFO("Notifying homekit that current door state is now '%s'\n", state_description(current_door_state));
 
-    // Find the target door state characteristic c:
-    homekit_accessory_t *accessory = accessories[0];
-    homekit_service_t *service = accessory->services[1];
-    homekit_characteristic_t *c = service->characteristics[2];
+    homekit_characteristic_t *c = gdo_characteristic(1);
+    DLOG_DEBUG("Notifying changed '%s'\n", c->description);
+    homekit_characteristic_notify(c, new_value);
+}
 
-    assert(c);
+void gdo_target_state_notify_homekit() {
+
+    homekit_value_t new_value = HOMEKIT_UINT8(target_door_state);
+    DLOG_INFO("Notifying homekit that target door state is now '%s'\n", state_description(target_door_state));
 
-    printf("Notifying changed '%s'\n", c->description);
+    homekit_characteristic_t *c = gdo_characteristic(2);
+    DLOG_DEBUG("Notifying changed '%s'\n", c->description);
     homekit_characteristic_notify(c, new_value);
 }
 
 void current_state_set(uint8_t new_state) {
+    uint8_t new_target = target_door_state;
+    switch (new_state) {
+        case HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN:
+        case HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING:
+            new_target = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_OPEN;
+            break;
+        case HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED:
+        case HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING:
+            new_target = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_CLOSED;
+            break;
+        default: ;
+    }
+
+    if (target_door_state != new_target) {
+        target_door_state = new_target;
+        gdo_target_state_notify_homekit();
+    }
     if (current_door_state != new_state) {
         current_door_state = new_state;
-        gdo_target_state_notify_homekit();
         gdo_current_state_notify_homekit();
     }
 }
 
-void current_door_state_update_from_sensor() {
-    contact_sensor_state_t sensor_state = contact_sensor_state_get(REED_PIN);
+bool door_sensor_closed() {
+    // The reed contact opens when the door is closed
+    return contact_sensor_state_get(REED_PIN) == CONTACT_OPEN;
+}
+
+void door_move(uint8_t moving_state) {
+    // Toggle the garage door by pulsing the relay, without blocking the caller:
+    relay_actor_pulse(RELAY_PIN, RELAY_PULSE_TIME);
+    current_state_set(moving_state);
 
-    switch (sensor_state) {
-        case CONTACT_CLOSED:
-            current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN);
+    // Wait for the garage door to open / close,
+    // then update current_door_state from sensor:
+    sdk_os_timer_disarm(&update_timer);
+    sdk_os_timer_arm(&update_timer, OPEN_CLOSE_DURATION * 1000, false);
+}
+
+/**
+ * Door state machine. The reed sensor only tells whether the door is closed,
+ * everything in between is tracked with update_timer.
+ * Only called from the door task, which serializes all events.
+ **/
+void door_event(door_event_t event) {
+    uint8_t state = current_door_state;
+    switch (event) {
+        case door_event_target_open:
+        case door_event_target_closed: {
+            bool open = event == door_event_target_open;
+            if (state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING ||
+                state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
+                DLOG_INFO("Target state ignored while door is %s.\n", state_description(state));
+                // Tell the controller the target didn't change:
+                gdo_target_state_notify_homekit();
+                break;
+            }
+            if ((open && state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN) ||
+                (!open && state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED)) {
+                DLOG_INFO("Target state ignored: door is already %s.\n", state_description(state));
+                break;
+            }
+            door_move(open ? HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING
+                           : HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING);
+            break;
+        }
+        case door_event_sensor_closed:
+            // Reaching the closed position finishes closing early. While
+            // opening, the door may not have left the sensor yet.
+            if (state != HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING) {
+                sdk_os_timer_disarm(&update_timer);
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED);
+            }
             break;
-        case CONTACT_OPEN:
-            current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED);
+        case door_event_sensor_not_closed:
+            if (state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED) {
+                // Moved by the wall button or the remote
+                DLOG_INFO("Door opened outside of HomeKit.\n");
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING);
+                sdk_os_timer_disarm(&update_timer);
+                sdk_os_timer_arm(&update_timer, OPEN_CLOSE_DURATION * 1000, false);
+            } else if (state != HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING &&
+                       state != HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN);
+            }
+            break;
+        case door_event_travel_timeout:
+            if (door_sensor_closed()) {
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED);
+            } else if (state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
+                // Should have reached the sensor by now (obstruction, reversed)
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_STOPPED);
+            } else {
+                current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN);
+            }
             break;
-        default:
-            printf("Unknown contact sensor event: %d\n", sensor_state);
     }
 }
 
-homekit_value_t gdo_current_state_get() {
-    if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_UNKNOWN) {
-	current_door_state_update_from_sensor();
+static void door_task(void *_args) {
+    door_event_t event;
+    while (1) {
+        if (xQueueReceive(door_queue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        door_event(event);
     }
-    printf("returning current door state '%s'.\n", state_description(current_door_state));
+}
+
+/**
+ * Hands an event over to the door task. Never blocks, so it is safe to call
+ * from timer callbacks.
+ **/
+void door_post(door_event_t event) {
+    if (xQueueSend(door_queue, &event, 0) != pdTRUE) {
+        DLOG_WARN("Door event %d dropped, queue full.\n", event);
+    }
+}
+
+homekit_value_t gdo_current_state_get() {
+    DLOG_DEBUG("Returning current door state '%s'.\n", state_description(current_door_state));
 
     return HOMEKIT_UINT8(current_door_state);
 }
 
 homekit_value_t gdo_target_state_get() {
-    uint8_t result = gdo_current_state_get().int_value;
-    if (result == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING) {
-	result = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_OPEN;
-    } else if (result == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
-        result = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_CLOSED;  
-    }
+    DLOG_DEBUG("Returning target door state '%s'.\n", state_description(target_door_state));
 
-    printf("Returning target door state '%s'.\n", state_description(result));
-
-    return HOMEKIT_UINT8(result);
+    return HOMEKIT_UINT8(target_door_state);
 }
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the contact sensor task once a state change has settled.
  **/
 void contact_sensor_state_changed(uint8_t gpio, contact_sensor_state_t state) {
 
-    printf("contact sensor state '%s'.\n", state == CONTACT_OPEN ? "open" : "closed");
+    DLOG_INFO("Contact sensor state '%s'.\n", state == CONTACT_OPEN ? "open" : "closed");
 
-    if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING ||
-        current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING) {
-	// Ignore the event - the state will be updated after the time expired!
-        printf("contact_sensor_state_changed() ignored during opening or closing.\n");
-	return;
-    }
-    current_door_state_update_from_sensor();
+    door_post(state == CONTACT_OPEN ? door_event_sensor_closed : door_event_sensor_not_closed);
 }
 
 
 void gdo_target_state_set(homekit_value_t new_value) {
 
     if (new_value.format != homekit_format_uint8) {
-        printf("Invalid value format: %d\n", new_value.format);
+        DLOG_WARN("Invalid value format: %d\n", new_value.format);
         return;
     }
 
-    if (current_door_state != HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN &&
-        current_door_state != HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED) {
-        printf("gdo_target_state_set() ignored: current state not open or closed (%s).\n", state_description(current_door_state));
-	return;
-    }
-
-    if (current_door_state == new_value.int_value) {
-        printf("gdo_target_state_set() ignored: new target state == current state (%s)\n", state_description(current_door_state));
-        return;
-    }
-
-    // Toggle the garage door by toggling the relay connected to the GPIO (on - off):
-    // Turn ON GPIO:
-    relay_write(true);
-    // Wait for some time:
-    vTaskDelay(400 / portTICK_PERIOD_MS);
-    // Turn OFF GPIO:
-    relay_write(false);
-    if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED) {
-        current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING);
-    } else {
-        current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSING);
-    }
-    // Wait for the garage door to open / close,
-    // then update current_door_state from sensor:
-    sdk_os_timer_arm(&update_timer, OPEN_CLOSE_DURATION * 1000, false);
+    door_post(new_value.int_value == HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_OPEN
+        ? door_event_target_open
+        : door_event_target_closed);
 }
 
 
 static void timer_callback(void *arg) {
 
-    printf("Timer fired. Updating state from sensor.\n");
+    DLOG_INFO("Timer fired. Updating state from sensor.\n");
     sdk_os_timer_disarm(&update_timer);
-    current_door_state_update_from_sensor();
+    door_post(door_event_travel_timeout);
 }
 
 
@@ -292,12 +354,22 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 9600);
+    deferred_log_init();
 
     wifi_init();
     relay_init();
 
+    door_queue = xQueueCreate(DOOR_QUEUE_SIZE, sizeof(door_event_t));
+    if (!door_queue || xTaskCreate(door_task, "Door", 512, NULL, 2, NULL) != pdPASS) {
+        printf("Failed to create door task\n");
+    }
+
     // Initialize Timer:
     sdk_os_timer_disarm(&update_timer);
     sdk_os_timer_setfn(&update_timer, timer_callback, NULL);
@@ -307,7 +379,13 @@ void user_init(void) {
     if (contact_sensor_create(REED_PIN, contact_sensor_state_changed)) {
         printf("Failed to initialize door\n");
     }
-
-    homekit_server_init(&config);
+    contact_sensor_set_debounce_time(REED_PIN, REED_DEBOUNCE_TIME);
+    if (door_sensor_closed()) {
+        current_door_state = HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED;
+        target_door_state = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_CLOSED;
+    } else {
+        current_door_state = HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN;
+        target_door_state = HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE_OPEN;
+    }
 
 }
@@ -6,4 +6,103 @@
 //  Copyright © 2018 Dirk Theisen. All rights reserved.
 //
 
+#include <string.h>
+#include <etstimer.h>
+#include <esplibs/libmain.h>
+#include <esp/gpio.h>
 #include "relay_actor.h"
+
+typedef struct {
+    uint8_t gpio_num;
+    bool active_value;
+
+    ETSTimer timer;
+    uint16_t durations[RELAY_ACTOR_MAX_STEPS];
+    uint8_t count;
+    uint8_t step;
+} relay_actor_t;
+
+
+static relay_actor_t relays[RELAY_ACTOR_MAX];
+static uint8_t relay_count = 0;
+
+
+static relay_actor_t *relay_actor_find_by_gpio(const uint8_t gpio_num) {
+    for (int i = 0; i < relay_count; i++)
+        if (relays[i].gpio_num == gpio_num)
+            return &relays[i];
+
+    return NULL;
+}
+
+static void relay_actor_write(relay_actor_t *relay, bool on) {
+    gpio_write(relay->gpio_num, on ? relay->active_value : !relay->active_value);
+}
+
+// Runs the next step of the sequence, even steps switch the relay on.
+static void relay_actor_step(void *arg) {
+    relay_actor_t *relay = arg;
+
+    sdk_os_timer_disarm(&relay->timer);
+    if (relay->step >= relay->count) {
+        relay_actor_write(relay, false);
+        relay->count = 0;
+        return;
+    }
+
+    relay_actor_write(relay, !(relay->step & 1));
+    sdk_os_timer_arm(&relay->timer, relay->durations[relay->step], false);
+    relay->step++;
+}
+
+int relay_actor_create(const uint8_t gpio_num, bool active_value) {
+    if (relay_actor_find_by_gpio(gpio_num) || relay_count >= RELAY_ACTOR_MAX)
+        return -1;
+
+    relay_actor_t *relay = &relays[relay_count++];
+    memset(relay, 0, sizeof(*relay));
+    relay->gpio_num = gpio_num;
+    relay->active_value = active_value;
+
+    sdk_os_timer_disarm(&relay->timer);
+    sdk_os_timer_setfn(&relay->timer, relay_actor_step, relay);
+
+    gpio_enable(gpio_num, GPIO_OUTPUT);
+    relay_actor_write(relay, false);
+
+    return 0;
+}
+
+void relay_actor_set(const uint8_t gpio_num, bool on) {
+    relay_actor_t *relay = relay_actor_find_by_gpio(gpio_num);
+    if (!relay)
+        return;
+
+    sdk_os_timer_disarm(&relay->timer);
+    relay->count = 0;
+    relay_actor_write(relay, on);
+}
+
+int relay_actor_pulse(const uint8_t gpio_num, uint16_t duration) {
+    return relay_actor_sequence(gpio_num, &duration, 1);
+}
+
+int relay_actor_sequence(const uint8_t gpio_num, const uint16_t *durations, uint8_t count) {
+    relay_actor_t *relay = relay_actor_find_by_gpio(gpio_num);
+    if (!relay || !count || count > RELAY_ACTOR_MAX_STEPS)
+        return -1;
+
+    sdk_os_timer_disarm(&relay->timer);
+    memcpy(relay->durations, durations, count * sizeof(*durations));
+    relay->count = count;
+    relay->step = 0;
+
+    relay_actor_step(relay);
+
+    return 0;
+}
+
+bool relay_actor_busy(const uint8_t gpio_num) {
+    relay_actor_t *relay = relay_actor_find_by_gpio(gpio_num);
+    return relay && relay->count;
+}
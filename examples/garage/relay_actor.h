@@ -10,5 +10,46 @@
 #define relay_actor_h
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Max number of relays and of steps in a pulse sequence
+#define RELAY_ACTOR_MAX 4
+#define RELAY_ACTOR_MAX_STEPS 8
+
+/**
+    Configures the given GPIO pin as a relay output and switches it off.
+
+    @param gpio_num The GPIO pin driving the relay
+    @param active_value The pin level that switches the relay on
+    @return A negative integer if this method fails.
+*/
+int relay_actor_create(uint8_t gpio_num, bool active_value);
+
+/**
+    Switches the relay on or off, cancelling any running pulse sequence.
+*/
+void relay_actor_set(uint8_t gpio_num, bool on);
+
+/**
+    Switches the relay on for duration milliseconds. Returns right away,
+    the relay is switched off from a timer.
+*/
+int relay_actor_pulse(uint8_t gpio_num, uint16_t duration);
+
+/**
+    Runs a pulse sequence: the relay is switched on for durations[0] ms,
+    off for durations[1] ms, on for durations[2] ms and so on. The relay
+    is always left off at the end. Replaces a running sequence, returns
+    right away.
+
+    @return A negative integer if this method fails.
+*/
+int relay_actor_sequence(uint8_t gpio_num, const uint16_t *durations, uint8_t count);
+
+/**
+    @return true while a pulse sequence is running.
+*/
+bool relay_actor_busy(uint8_t gpio_num);
 
 #endif /* relay_actor_h */
@@ -9,7 +9,9 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 #include <led_status.h>
+#include <boot_profiler.h>
 
 
 static led_status_pattern_t unpaired = { .n=2, .delay=(int[]){ 1000, 1000 } };
@@ -17,15 +19,26 @@ static led_status_pattern_t pairing = { .n=5, .delay=(int[]){ 100, 100, 100, 600
 static led_status_pattern_t normal_mode = { 2, (int[]){ 100, 9900 } };
 
 
+void on_wifi_ready();
+
+void on_wifi_event(wifi_manager_event_t event) {
+    if (event == wifi_manager_event_associated) {
+        boot_profiler_mark(boot_phase_wifi_associated);
+    }
+    else if (event == wifi_manager_event_got_ip) {
+        boot_profiler_mark(boot_phase_got_ip);
+    }
+}
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
+        .on_event = on_wifi_event,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 const int led_gpio = 2;
@@ -104,12 +117,17 @@ static bool paired = false;
 
 void on_event(homekit_event_t event) {
     if (event == HOMEKIT_EVENT_SERVER_INITIALIZED) {
+        boot_profiler_mark(boot_phase_server_ready);
         led_status_set(led_status, paired ? &normal_mode : &unpaired);
     }
     else if (event == HOMEKIT_EVENT_CLIENT_CONNECTED) {
         if (!paired)
             led_status_set(led_status, &pairing);
     }
+    else if (event == HOMEKIT_EVENT_CLIENT_VERIFIED) {
+        if (boot_profiler_mark(boot_phase_first_verify))
+            boot_profiler_report();
+    }
     else if (event == HOMEKIT_EVENT_CLIENT_DISCONNECTED) {
         if (!paired)
             led_status_set(led_status, &unpaired);
@@ -128,13 +146,17 @@ homekit_server_config_t config = {
 };
 
 
+void on_wifi_ready() {
+    boot_profiler_mark(boot_phase_homekit_init);
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    boot_profiler_init();
 
     wifi_init();
 
     paired = homekit_is_paired();
     led_status = led_status_init(led_gpio);
-
-    homekit_server_init(&config);
 }
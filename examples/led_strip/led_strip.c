@@ -18,12 +18,15 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <color.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 #include "ws2812_i2s/ws2812_i2s.h"
+#include <ws2812_frame.h>
+#include <animation.h>
 
 #define LED_ON 0                // this is the value to write to GPIO for led on (0 = GPIO low)
 #define LED_INBUILT_GPIO 2      // this is the onboard LED used to show on/off only
@@ -35,60 +38,34 @@ float led_hue = 0;              // hue is scaled 0 to 360
 float led_saturation = 59;      // saturation is scaled 0 to 100
 float led_brightness = 100;     // brightness is scaled 0 to 100
 bool led_on = false;            // on is boolean on or off
-ws2812_pixel_t pixels[LED_COUNT];
+ws2812_frame_buffer_t frame;
+ws2812_frame_pipeline_t pipeline;
+ws2812_pixel_t led_color = { { 0, 0, 0, 0 } };  // current color at full intensity
+uint8_t led_level = LED_RGB_SCALE;              // current brightness level
 
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
 static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
+    color_rgbw_t color;
+    color_hsi2rgb(h, s, i, LED_RGB_SCALE, COLOR_FLAG_SHAPE_INTENSITY, &color);
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
+    rgb->red = (uint8_t) color.red;
+    rgb->green = (uint8_t) color.green;
+    rgb->blue = (uint8_t) color.blue;
     rgb->white = (uint8_t) 0;           // white channel is not used
 }
 
-void led_string_fill(ws2812_pixel_t rgb) {
-
-    // write out the new color to each pixel
-    for (int i = 0; i < LED_COUNT; i++) {
-        pixels[i] = rgb;
-    }
-    ws2812_i2s_update(pixels, PIXEL_RGB);
+void led_string_effect(ws2812_pixel_t *pixels, size_t count, uint32_t time_ms, void *context) {
+    // brightness is applied by the pipeline, which is only touched from the animation task
+    ws2812_frame_pipeline_set_brightness(&pipeline, led_level);
+    ws2812_frame_fill(&pipeline, led_color, pixels, count);
 }
 
 void led_string_set(void) {
     ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
 
     if (led_on) {
-        // convert HSI to RGBW
-        hsi2rgb(led_hue, led_saturation, led_brightness, &rgb);
+        // convert HSI to RGBW at full intensity
+        hsi2rgb(led_hue, led_saturation, 100, &rgb);
+        led_level = color_intensity(led_brightness, LED_RGB_SCALE, COLOR_FLAG_SHAPE_INTENSITY);
         //printf("h=%d,s=%d,b=%d => ", (int)led_hue, (int)led_saturation, (int)led_brightness);
         //printf("r=%d,g=%d,b=%d,w=%d\n", rgbw.red, rgbw.green, rgbw.blue, rgbw.white);
 
@@ -100,19 +77,21 @@ void led_string_set(void) {
         gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
     }
 
-    // write out the new color 
-    led_string_fill(rgb);
+    // write out the new color
+    led_color = rgb;
+    animation_refresh();
 }
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 void led_init() {
@@ -121,34 +100,39 @@ void led_init() {
 
     // initialise the LED strip
     ws2812_i2s_init(LED_COUNT, PIXEL_RGB);
+    ws2812_frame_buffer_init(&frame, LED_COUNT, PIXEL_RGB, NULL);
+    ws2812_frame_pipeline_init(&pipeline, NULL, LED_RGB_SCALE);
+    animation_init(&frame);
 
-    // set the initial state
+    // set the initial state, static color only needs to be refreshed when it changes
     led_string_set();
+    animation_set_effect(led_string_effect, 1, NULL);
 }
 
-void led_identify_task(void *_args) {
+bool led_identify_overlay(ws2812_pixel_t *pixels, size_t count, uint32_t time_ms, void *context) {
     const ws2812_pixel_t COLOR_PINK = { { 255, 0, 127, 0 } };
     const ws2812_pixel_t COLOR_BLACK = { { 0, 0, 0, 0 } };
 
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            gpio_write(LED_INBUILT_GPIO, LED_ON);
-            led_string_fill(COLOR_PINK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
-            led_string_fill(COLOR_BLACK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-        }
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+    // 3 series of 3 blinks (100ms on, 100ms off) followed by 250ms pause
+    if (time_ms >= 3 * 850) {
+        gpio_write(LED_INBUILT_GPIO, led_on ? LED_ON : 1 - LED_ON);
+        return false;
     }
 
-    led_string_set();
-    vTaskDelete(NULL);
+    uint32_t t = time_ms % 850;
+    bool on = (t < 600) && (t % 200 < 100);
+
+    gpio_write(LED_INBUILT_GPIO, on ? LED_ON : 1 - LED_ON);
+    for (int i = 0; i < count; i++) {
+        pixels[i] = on ? COLOR_PINK : COLOR_BLACK;
+    }
+
+    return true;
 }
 
 void led_identify(homekit_value_t _value) {
     // printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    animation_start_overlay(led_identify_overlay, 20, NULL);
 }
 
 homekit_value_t led_on_get() {
@@ -250,6 +234,10 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     // uart_set_baud(0, 115200);
 
@@ -265,5 +253,4 @@ void user_init(void) {
 
     wifi_init();
     led_init();
-    homekit_server_init(&config);
 }
@@ -23,13 +23,18 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <color.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
 #include "WS2812FX/WS2812FX.h"
+#include <health_metrics.h>
 
 #define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
 #define LED_COUNT 50            // this is the number of WS2812B leds on the strip
 #define LED_INBUILT_GPIO 2      // this is the onboard LED used to show on/off only
+#define HEALTH_SAMPLE_PERIOD 5000     // free heap and stacks are sampled this often (ms)
+#define HEALTH_REPORT_PERIOD 60000    // and printed to UART this often (ms)
 
 // Global variables
 float led_hue = 0;              // hue is scaled 0 to 360
@@ -43,52 +48,26 @@ float fx_saturation = 50;      // saturation is scaled 0 to 100
 float fx_brightness = 50;     // brightness is scaled 0 to 100
 bool fx_on = true;
 
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
 static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
+    color_rgbw_t color;
+    color_hsi2rgb(h, s, i, LED_RGB_SCALE, COLOR_FLAG_SHAPE_INTENSITY, &color);
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
+    rgb->red = (uint8_t) color.red;
+    rgb->green = (uint8_t) color.green;
+    rgb->blue = (uint8_t) color.blue;
     rgb->white = (uint8_t) 0;           // white channel is not used
 }
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 
@@ -121,6 +100,8 @@ homekit_value_t led_on_get() {
 }
 
 void led_on_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_bool) {
         // printf("Invalid on-value format: %d\n", value.format);
         return;
@@ -141,6 +122,8 @@ homekit_value_t led_brightness_get() {
 }
 
 void led_brightness_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_int) {
         // printf("Invalid brightness-value format: %d\n", value.format);
         return;
@@ -155,6 +138,8 @@ homekit_value_t led_hue_get() {
 }
 
 void led_hue_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_float) {
         // printf("Invalid hue-value format: %d\n", value.format);
         return;
@@ -172,6 +157,8 @@ homekit_value_t led_saturation_get() {
 }
 
 void led_saturation_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_float) {
         // printf("Invalid sat-value format: %d\n", value.format);
         return;
@@ -189,6 +176,8 @@ homekit_value_t fx_on_get() {
 }
 
 void fx_on_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_bool) {
         // printf("Invalid on-value format: %d\n", value.format);
         return;
@@ -207,6 +196,8 @@ homekit_value_t fx_brightness_get() {
 }
 
 void fx_brightness_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_int) {
         // printf("Invalid brightness-value format: %d\n", value.format);
         return;
@@ -229,6 +220,8 @@ homekit_value_t fx_hue_get() {
 }
 
 void fx_hue_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_float) {
         // printf("Invalid hue-value format: %d\n", value.format);
         return;
@@ -243,6 +236,8 @@ homekit_value_t fx_saturation_get() {
 }
 
 void fx_saturation_set(homekit_value_t value) {
+    health_metrics_count(health_metrics_setter_calls);
+
     if (value.format != homekit_format_float) {
         // printf("Invalid hue-value format: %d\n", value.format);
         return;
@@ -311,6 +306,7 @@ homekit_accessory_t *accessories[] = {
                 ),
             NULL
         }),
+        &health_metrics_service,
         NULL
     }),
     NULL
@@ -321,6 +317,10 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     // uart_set_baud(0, 115200);
 
@@ -336,7 +336,8 @@ void user_init(void) {
 
     wifi_init();
     WS2812FX_init(LED_COUNT);
-    homekit_server_init(&config);
+    health_metrics_init(HEALTH_SAMPLE_PERIOD, HEALTH_REPORT_PERIOD);
+    health_metrics_watch(accessories);
     
     led_identify(HOMEKIT_INT(led_brightness));
 }
\ No newline at end of file
@@ -11,17 +11,18 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <espressif/esp_wifi.h>
 #include <espressif/esp_sta.h>
 #include <esp/uart.h>
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h> 
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
+#include <color.h>
 
 #include "multipwm.h"
 
@@ -53,40 +54,34 @@ float led_saturation = 59;      // saturation is scaled 0 to 100
 float led_brightness = 100;     // brightness is scaled 0 to 100
 bool led_on = false;            // on is boolean on or off
 
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
+TaskHandle_t multipwm_task_handle = NULL;
+
 static void hsi2rgb(float h, float s, float i, rgb_color_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    //i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
+    color_rgbw_t color;
+    color_hsi2rgb(h, s, i, LED_RGB_SCALE, 0, &color);
+
+    rgb->red = color.red;
+    rgb->green = color.green;
+    rgb->blue = color.blue;
+}
+
+// Sets new target color and wakes up transition task
+void led_set_target(rgb_color_t color) {
+    target_color = color;
+
+    if (multipwm_task_handle)
+        xTaskNotifyGive(multipwm_task_handle);
+}
+
+void led_update() {
+    rgb_color_t color = { { 0, 0, 0, 0 } };
+
+    if (led_on) {
+        // convert HSI to RGBW
+        hsi2rgb(led_hue, led_saturation, led_brightness, &color);
     }
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
+    led_set_target(color);
 }
 
 void led_identify_task(void *_args) {
@@ -98,17 +93,17 @@ void led_identify_task(void *_args) {
     
     for (int i=0; i<3; i++) {
         for (int j=0; j<2; j++) {
-            target_color = white_color;
+            led_set_target(white_color);
             vTaskDelay(100 / portTICK_PERIOD_MS);
             
-            target_color = black_color;
+            led_set_target(black_color);
             vTaskDelay(100 / portTICK_PERIOD_MS);
         }
 
         vTaskDelay(250 / portTICK_PERIOD_MS);
     }
 
-    target_color = color;
+    led_set_target(color);
 
     vTaskDelete(NULL);
 }
@@ -128,6 +123,7 @@ void led_on_set(homekit_value_t value) {
     }
 
     led_on = value.bool_value;
+    led_update();
 }
 
 homekit_value_t led_brightness_get() {
@@ -140,6 +136,7 @@ void led_brightness_set(homekit_value_t value) {
         return;
     }
     led_brightness = value.int_value;
+    led_update();
 }
 
 homekit_value_t led_hue_get() {
@@ -152,6 +149,7 @@ void led_hue_set(homekit_value_t value) {
         return;
     }
     led_hue = value.float_value;
+    led_update();
 }
 
 homekit_value_t led_saturation_get() {
@@ -164,6 +162,7 @@ void led_saturation_set(homekit_value_t value) {
         return;
     }
     led_saturation = value.float_value;
+    led_update();
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "LED Strip");
@@ -213,9 +212,21 @@ homekit_server_config_t config = {
     .password = "190-11-978"    //changed tobe valid
 };
 
+// Moves channel one low-pass filter step towards target, returns true when it got there
+static bool lpf_step(uint16_t *current, uint16_t target) {
+    int32_t diff = (target * 256) - *current;
+
+    if (abs(diff) < (1 << LPF_SHIFT)) {
+        *current = target * 256;
+    } else {
+        *current += diff >> LPF_SHIFT;
+    }
+
+    return *current == target * 256;
+}
+
 IRAM void multipwm_task(void *pvParameters) {
     const TickType_t xPeriod = pdMS_TO_TICKS(LPF_INTERVAL);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
     
     uint8_t pins[] = {RED_PWM_PIN, GREEN_PWM_PIN, BLUE_PWM_PIN};
 
@@ -229,26 +240,31 @@ IRAM void multipwm_task(void *pvParameters) {
     }
 
     while(1) {
-        if (led_on) {
-            // convert HSI to RGBW
-            hsi2rgb(led_hue, led_saturation, led_brightness, &target_color);
-        } else {
-            target_color.red = 0;
-            target_color.green = 0;
-            target_color.blue = 0;
-        }
-        
-        current_color.red += ((target_color.red * 256) - current_color.red) >> LPF_SHIFT ;
-        current_color.green += ((target_color.green * 256) - current_color.green) >> LPF_SHIFT ;
-        current_color.blue += ((target_color.blue * 256) - current_color.blue) >> LPF_SHIFT ;
-        
-        multipwm_stop(&pwm_info);
-        multipwm_set_duty(&pwm_info, 0, current_color.red);
-        multipwm_set_duty(&pwm_info, 1, current_color.green);
-        multipwm_set_duty(&pwm_info, 2, current_color.blue);
-        multipwm_start(&pwm_info);
-                
-        vTaskDelayUntil(&xLastWakeTime, xPeriod);
+        // Sleep until target color changes
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Run transition until output reaches the target
+        TickType_t xLastWakeTime = xTaskGetTickCount();
+        bool converged;
+        do {
+            rgb_color_t target = target_color;
+            rgb_color_t previous = current_color;
+
+            converged = lpf_step(&current_color.red, target.red);
+            converged &= lpf_step(&current_color.green, target.green);
+            converged &= lpf_step(&current_color.blue, target.blue);
+
+            if (current_color.color != previous.color) {
+                multipwm_stop(&pwm_info);
+                multipwm_set_duty(&pwm_info, 0, current_color.red);
+                multipwm_set_duty(&pwm_info, 1, current_color.green);
+                multipwm_set_duty(&pwm_info, 2, current_color.blue);
+                multipwm_start(&pwm_info);
+            }
+
+            if (!converged)
+                vTaskDelayUntil(&xLastWakeTime, xPeriod);
+        } while (!converged);
     }
 }
 
@@ -271,5 +287,6 @@ void user_init(void) {
 
     wifi_config_init("MagicHome Led Strip", NULL, on_wifi_ready);
     
-    xTaskCreate(multipwm_task, "multipwm", 256, NULL, 2, NULL);
+    xTaskCreate(multipwm_task, "multipwm", 256, NULL, 2, &multipwm_task_handle);
+    led_update();
 }
@@ -28,6 +28,7 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
 
 #define QRCODE_VERSION 2
@@ -143,15 +144,16 @@ void qrcode_hide() {
     qrcode_shown = false;
 }
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 const int led_gpio = 2;
@@ -262,6 +264,10 @@ void generate_random_setup_id(char *setup_id) {
 char password[11];
 char setup_id[5];
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
@@ -278,6 +284,4 @@ void user_init(void) {
     if (!homekit_is_paired()) {
         qrcode_show(&config);
     }
-
-    homekit_server_init(&config);
 }
@@ -28,6 +28,7 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
 
 #define QRCODE_VERSION 2
@@ -85,15 +86,16 @@ void hide_password() {
     password_displayed = false;
 }
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 const int led_gpio = 2;
@@ -187,6 +189,10 @@ homekit_server_config_t config = {
     .on_event = on_homekit_event,
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
@@ -194,6 +200,4 @@ void user_init(void) {
 
     wifi_init();
     led_init();
-
-    homekit_server_init(&config);
 }
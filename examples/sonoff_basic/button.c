@@ -1,7 +1,15 @@
+#include <stdlib.h>
 #include <string.h>
 #include <esplibs/libmain.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
 #include "button.h"
 
+// GPIO0 - GPIO16
+#define BUTTON_MAX_GPIO 17
+#define BUTTON_QUEUE_SIZE 8
+
 typedef struct _button {
     uint8_t gpio_num;
     button_callback_fn callback;
@@ -13,25 +21,47 @@ typedef struct _button {
 
     uint32_t last_press_time;
     uint32_t last_event_time;
-
-    struct _button *next;
 } button_t;
 
+typedef struct {
+    button_callback_fn callback;
+    uint8_t gpio_num;
+    button_event_t event;
+} button_message_t;
+
+
+static button_t *buttons[BUTTON_MAX_GPIO];
+static QueueHandle_t button_queue = NULL;
+
 
-button_t *buttons = NULL;
+static void button_post(button_t *button, button_event_t event) {
+    button_message_t message = {
+        .callback = button->callback,
+        .gpio_num = button->gpio_num,
+        .event = event,
+    };
+
+    // Callbacks are not ISR-safe (they notify HomeKit controllers),
+    // so hand the event over to the button task instead.
+    BaseType_t task_woken = pdFALSE;
+    xQueueSendFromISR(button_queue, &message, &task_woken);
+    portEND_SWITCHING_ISR(task_woken);
+}
 
 
-static button_t *button_find_by_gpio(const uint8_t gpio_num) {
-    button_t *button = buttons;
-    while (button && button->gpio_num != gpio_num)
-        button = button->next;
+static void button_task(void *_args) {
+    button_message_t message;
+    while (1) {
+        if (xQueueReceive(button_queue, &message, portMAX_DELAY) != pdTRUE)
+            continue;
 
-    return button;
+        message.callback(message.gpio_num, message.event);
+    }
 }
 
 
 void button_intr_callback(uint8_t gpio) {
-    button_t *button = button_find_by_gpio(gpio);
+    button_t *button = (gpio < BUTTON_MAX_GPIO) ? buttons[gpio] : NULL;
     if (!button)
         return;
 
@@ -48,27 +78,39 @@ void button_intr_callback(uint8_t gpio) {
     } else {
         // The button is released. Handle the use cases.
         if ((now - button->last_press_time) * portTICK_PERIOD_MS > button->long_press_time) {
-         	if (button->last_press_time > 0)
-            	{
-            	button->callback(button->gpio_num, button_event_long_press);
-            	button->last_press_time = 0;
-            	}
+            if (button->last_press_time > 0) {
+                button_post(button, button_event_long_press);
+                button->last_press_time = 0;
+            }
         } else {
-            if (button->last_press_time > 0)
-            	{
-            	button->callback(button->gpio_num, button_event_single_press);
-            	button->last_press_time = 0;
-            	}
+            if (button->last_press_time > 0) {
+                button_post(button, button_event_single_press);
+                button->last_press_time = 0;
+            }
         }
     }
 }
 
 int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_press_time, button_callback_fn callback) {
-    button_t *button = button_find_by_gpio(gpio_num);
-    if (button)
+    if (gpio_num >= BUTTON_MAX_GPIO || buttons[gpio_num])
+        return -1;
+
+    if (!button_queue) {
+        button_queue = xQueueCreate(BUTTON_QUEUE_SIZE, sizeof(button_message_t));
+        if (!button_queue)
+            return -1;
+
+        if (xTaskCreate(button_task, "Button", 512, NULL, 2, NULL) != pdPASS) {
+            vQueueDelete(button_queue);
+            button_queue = NULL;
+            return -1;
+        }
+    }
+
+    button_t *button = malloc(sizeof(button_t));
+    if (!button)
         return -1;
 
-    button = malloc(sizeof(button_t));
     memset(button, 0, sizeof(*button));
     button->gpio_num = gpio_num;
     button->callback = callback;
@@ -82,8 +124,7 @@ int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_pres
     button->last_event_time = now;
     button->last_press_time = 0;
 
-    button->next = buttons;
-    buttons = button;
+    buttons[gpio_num] = button;
 
     gpio_set_pullup(button->gpio_num, true, true);
     gpio_set_interrupt(button->gpio_num, GPIO_INTTYPE_EDGE_ANY, button_intr_callback);
@@ -93,26 +134,16 @@ int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_pres
 
 
 void button_delete(const uint8_t gpio_num) {
-    if (!buttons)
+    if (gpio_num >= BUTTON_MAX_GPIO)
         return;
 
-    button_t *button = NULL;
-    if (buttons->gpio_num == gpio_num) {
-        button = buttons;
-        buttons = buttons->next;
-    } else {
-        button_t *b = buttons;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                button = b->next;
-                b->next = b->next->next;
-                break;
-            }
-        }
-    }
+    button_t *button = buttons[gpio_num];
+    if (!button)
+        return;
 
-    if (button) {
-        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
-    }
+    // Events already queued carry their own callback, so the button
+    // can be released as soon as its interrupt is detached.
+    gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+    buttons[gpio_num] = NULL;
+    free(button);
 }
-
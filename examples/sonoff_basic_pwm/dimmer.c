@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "pwm.h"
+#include "dimmer.h"
+
+
+#define DIMMER_FADE_INTERVAL 10                     // in milliseconds
+#define DIMMER_FADE_STEP (UINT16_MAX / 20)          // full fade in 200ms
+
+
+static TaskHandle_t dimmer_task_handle = NULL;
+static volatile uint16_t dimmer_target_duty = UINT16_MAX;
+static uint16_t dimmer_duty = UINT16_MAX;
+
+
+static void dimmer_task(void *_args) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Always apply at least once, as identify could have changed duty behind our back
+        do {
+            uint16_t target = dimmer_target_duty;
+            if (abs(target - dimmer_duty) <= DIMMER_FADE_STEP) {
+                dimmer_duty = target;
+            } else if (target > dimmer_duty) {
+                dimmer_duty += DIMMER_FADE_STEP;
+            } else {
+                dimmer_duty -= DIMMER_FADE_STEP;
+            }
+            pwm_set_duty(dimmer_duty);
+
+            if (dimmer_duty != target)
+                vTaskDelay(DIMMER_FADE_INTERVAL / portTICK_PERIOD_MS);
+        } while (dimmer_duty != dimmer_target_duty);
+    }
+}
+
+
+int dimmer_start(uint16_t duty) {
+    if (dimmer_task_handle)
+        return 0;
+
+    dimmer_duty = dimmer_target_duty = duty;
+    if (xTaskCreate(dimmer_task, "Dimmer", 256, NULL, 2, &dimmer_task_handle) != pdPASS) {
+        dimmer_task_handle = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void dimmer_set(uint16_t duty) {
+    dimmer_target_duty = duty;
+
+    if (dimmer_task_handle)
+        xTaskNotifyGive(dimmer_task_handle);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+    Starts the dimming worker. It owns the PWM duty from then on and fades
+    towards the latest target set with dimmer_set().
+
+    @param duty The duty PWM is currently at
+    @return A negative integer if this method fails.
+*/
+int dimmer_start(uint16_t duty);
+
+/**
+    Sets the duty to fade to. Only the target is stored, so bursts of calls
+    (e.g. a slider drag) collapse into one fade towards the latest value.
+    Also reapplies the duty if someone else changed it (e.g. identify).
+
+    @param duty Target PWM duty
+*/
+void dimmer_set(uint16_t duty);
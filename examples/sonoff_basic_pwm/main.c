@@ -38,6 +38,7 @@ modified to do pulse-width-modulation (PWM) of LED
 
 #include "button.h"
 #include "toggle.h"
+#include "dimmer.h"
 
 // The GPIO pin that is connected to the relay on the Sonoff Basic.
 const int relay_gpio = 12;
@@ -109,22 +110,18 @@ void gpio_init() {
 }
 
 
-void lightSET_task(void *pvParameters) {
-    int w;
+// Dimming is done by a single worker task (dimmer.c) that fades towards
+// the latest duty set here.
+void lightSET() {
+    uint16_t duty = UINT16_MAX;
     if (on) {
-        w = (UINT16_MAX - UINT16_MAX*bri/100);
-        pwm_set_duty(w);
-        printf("ON  %3d [%5d]\n", (int)bri , w);
+        duty = (UINT16_MAX - UINT16_MAX*bri/100);
+        printf("ON  %3d [%5d]\n", (int)bri , duty);
     } else {
         printf("OFF\n");
-        pwm_set_duty(UINT16_MAX);
     }
-    vTaskDelete(NULL);
-}
 
-
-void lightSET() {
-    xTaskCreate(lightSET_task, "Light Set", 256, NULL, 2, NULL);
+    dimmer_set(duty);
 }
 
 
@@ -137,6 +134,9 @@ void light_init() {
     printf("PWMpwm_set_freq = 1000 Hz  pwm_set_duty = 0 = 0%%\n");
     pwm_set_duty(UINT16_MAX);
     pwm_start();
+    if (dimmer_start(UINT16_MAX)) {
+        printf("Failed to start dimmer\n");
+    }
     lightSET();
 }
 
@@ -4,12 +4,23 @@
  * Copyright (C) 2015 Guillem Pascual Ginovart (https://github.com/gpascualg)
  * Copyright (C) 2015 Javier Cardona (https://github.com/jcard0na)
  * BSD Licensed as described in the file LICENSE
+ *
+ * Every channel has its own duty. Channel edges within a period are sorted
+ * into a schedule, so the timer is reloaded once per distinct edge:
+ * all channels are turned on at the start of the period and each interrupt
+ * turns off channels that end at that point. New duties are built into a
+ * second schedule which the interrupt handler picks up at the start of the
+ * next period, so the timer never has to be stopped to change duty.
+ * When no channel toggles within a period (all at 0% or 100%) the timer is
+ * stopped after the outputs are set and restarted by the next update.
  */
 #include "pwm.h"
 
+#include <string.h>
 #include <espressif/esp_common.h>
 #include <espressif/sdk_private.h>
 #include <FreeRTOS.h>
+#include <task.h>
 #include <esp8266.h>
 
 #ifdef PWM_DEBUG
@@ -18,60 +29,152 @@
 #define debug(fmt, ...)
 #endif
 
+/* Edges closer than this (in timer ticks) are merged, as interrupt
+   can not be served faster than that */
+#define PWM_MIN_LOAD    16
+
 typedef struct PWMPinDefinition
 {
     uint8_t pin;
-    uint8_t divider;
+    uint16_t dutyCycle;
 } PWMPin;
 
-typedef enum {
-    PERIOD_ON   = 0,
-    PERIOD_OFF  = 1
-} pwm_step_t;
-
+typedef struct pwmScheduleDefinition
+{
+    uint32_t onMask;        /* pins turned on at the start of period */
+    uint8_t edges;          /* number of edges in a period */
+    uint32_t edgeMask[MAX_PWM_PINS];    /* pins turned off at each edge */
+    uint32_t load[MAX_PWM_PINS + 1];    /* ticks from previous edge to next one */
+} PWMSchedule;
 
 typedef struct pwmInfoDefinition
 {
     uint8_t running;
-    bool output;
     bool reverse;
 
     uint16_t freq;
-    uint16_t dutyCycle;
 
     /* private */
     uint32_t _maxLoad;
-    uint32_t _onLoad;
-    uint32_t _offLoad;
-    pwm_step_t _step;
+    uint32_t _pinMask;
+
+    PWMSchedule _schedules[2];
+    PWMSchedule * volatile _active;
+    PWMSchedule * volatile _pending;
+    uint8_t _phase;
+    volatile bool _idle;    /* timer stopped, outputs are constant */
+    volatile uint32_t _isrCount;
 
     uint16_t usedPins;
-    PWMPin pins[8];
+    PWMPin pins[MAX_PWM_PINS];
 } PWMInfo;
 
 static PWMInfo pwmInfo;
 
+static inline void IRAM pwm_write_pins(uint32_t onMask, uint32_t offMask)
+{
+    if (pwmInfo.reverse)
+    {
+        uint32_t t = onMask;
+        onMask = offMask;
+        offMask = t;
+    }
+    if (offMask)
+        GPIO.OUT_CLEAR = offMask;
+    if (onMask)
+        GPIO.OUT_SET = onMask;
+}
+
 static void IRAM frc1_interrupt_handler(void *arg)
 {
-    uint8_t i = 0;
-    bool out = true;
-    uint32_t load = pwmInfo._onLoad;
-    pwm_step_t step = PERIOD_ON;
+    PWMSchedule *schedule = pwmInfo._active;
+    uint8_t phase = pwmInfo._phase;
 
-    if (pwmInfo._step == PERIOD_ON)
+    if (phase == 0)
+    {
+        /* Period boundary: switch to new duties, if any */
+        if (pwmInfo._pending)
+        {
+            schedule = pwmInfo._active = pwmInfo._pending;
+            pwmInfo._pending = NULL;
+        }
+        pwm_write_pins(schedule->onMask, pwmInfo._pinMask & ~schedule->onMask);
+
+        if (!schedule->edges)
+        {
+            /* Nothing toggles, no need to interrupt every period */
+            timer_set_run(FRC1, false);
+            pwmInfo._idle = true;
+            pwmInfo._isrCount++;
+            return;
+        }
+    }
+    else
     {
-        out = false;
-        load = pwmInfo._offLoad;
-        step = PERIOD_OFF;
+        pwm_write_pins(0, schedule->edgeMask[phase - 1]);
     }
 
-    for (; i < pwmInfo.usedPins; ++i)
+    timer_set_load(FRC1, schedule->load[phase]);
+    pwmInfo._phase = (phase < schedule->edges) ? phase + 1 : 0;
+    pwmInfo._isrCount++;
+}
+
+static void pwm_build_schedule(PWMSchedule *schedule)
+{
+    uint32_t maxLoad = pwmInfo._maxLoad;
+    uint32_t edgeLoad[MAX_PWM_PINS];
+    uint8_t edges = 0;
+
+    schedule->onMask = 0;
+
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
     {
-         gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? !out : out);
+        uint16_t duty = pwmInfo.pins[i].dutyCycle;
+        uint32_t mask = BIT(pwmInfo.pins[i].pin);
+
+        /* 0% and 100% duty cycle are special cases: constant output. */
+        if (duty == 0)
+            continue;
+
+        schedule->onMask |= mask;
+        if (duty == UINT16_MAX)
+            continue;
+
+        uint32_t load = (uint64_t)duty * maxLoad / UINT16_MAX;
+        if (load < PWM_MIN_LOAD)
+            load = PWM_MIN_LOAD;
+        if (load > maxLoad - PWM_MIN_LOAD)
+            load = maxLoad - PWM_MIN_LOAD;
+
+        /* Insert edge keeping edges sorted, merge edges that are too close */
+        uint8_t j = 0;
+        while (j < edges && edgeLoad[j] + PWM_MIN_LOAD <= load)
+            j++;
+
+        if (j < edges && edgeLoad[j] < load + PWM_MIN_LOAD)
+        {
+            schedule->edgeMask[j] |= mask;
+            continue;
+        }
+
+        for (uint8_t k = edges; k > j; k--)
+        {
+            edgeLoad[k] = edgeLoad[k - 1];
+            schedule->edgeMask[k] = schedule->edgeMask[k - 1];
+        }
+        edgeLoad[j] = load;
+        schedule->edgeMask[j] = mask;
+        edges++;
     }
 
-    timer_set_load(FRC1, load);
-    pwmInfo._step = step;
+    uint32_t previous = 0;
+    for (uint8_t j = 0; j < edges; j++)
+    {
+        schedule->load[j] = edgeLoad[j] - previous;
+        previous = edgeLoad[j];
+    }
+    schedule->load[edges] = maxLoad - previous;
+    schedule->edges = edges;
 }
 
 void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
@@ -84,11 +187,9 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
     }
 
     /* Initialize */
-    pwmInfo._maxLoad = 0;
-    pwmInfo._onLoad = 0;
-    pwmInfo._offLoad = 0;
-    pwmInfo._step = PERIOD_ON;
+    memset(&pwmInfo, 0, sizeof(pwmInfo));
     pwmInfo.reverse = reverse;
+    pwmInfo._active = &pwmInfo._schedules[0];
 
     /* Save pins information */
     pwmInfo.usedPins = npins;
@@ -96,7 +197,15 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
     uint8_t i = 0;
     for (; i < npins; ++i)
     {
+        if (pins[i] > 15)
+        {
+            debug("GPIO%d can not be used for PWM", pins[i]);
+            pwmInfo.usedPins = i;
+            break;
+        }
+
         pwmInfo.pins[i].pin = pins[i];
+        pwmInfo._pinMask |= BIT(pins[i]);
 
         /* configure GPIOs */
         gpio_enable(pins[i], GPIO_OUTPUT);
@@ -136,15 +245,56 @@ void pwm_set_freq(uint16_t freq)
     }
 }
 
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= pwmInfo.usedPins)
+        return;
+
+    pwmInfo.pins[channel].dutyCycle = duty;
+    debug("Duty of channel %u set at %u", channel, duty);
+}
+
 void pwm_set_duty(uint16_t duty)
 {
-    pwmInfo.dutyCycle = duty;
-    if (duty == 0 || duty == UINT16_MAX)
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
     {
-        pwmInfo.output = (duty == UINT16_MAX);
+        pwm_set_channel_duty(i, duty);
     }
-    debug("Duty set at %u",pwmInfo.dutyCycle);
-    pwm_restart();
+    pwm_update();
+}
+
+void pwm_update()
+{
+    if (!pwmInfo.running)
+    {
+        pwm_build_schedule(pwmInfo._active);
+        return;
+    }
+
+    /* Build new schedule outside of critical section, only hand it over inside */
+    PWMSchedule schedule;
+    pwm_build_schedule(&schedule);
+
+    taskENTER_CRITICAL();
+    PWMSchedule *inactive = (pwmInfo._active == &pwmInfo._schedules[0]) ?
+        &pwmInfo._schedules[1] : &pwmInfo._schedules[0];
+    *inactive = schedule;
+    pwmInfo._pending = inactive;
+    if (pwmInfo._idle)
+    {
+        /* Timer was stopped at a period boundary, the next interrupt
+           starts a new period with the pending schedule */
+        pwmInfo._idle = false;
+        pwmInfo._phase = 0;
+        timer_set_load(FRC1, PWM_MIN_LOAD);
+        timer_set_run(FRC1, true);
+    }
+    taskEXIT_CRITICAL();
+}
+
+uint32_t pwm_get_isr_count()
+{
+    return pwmInfo._isrCount;
 }
 
 void pwm_restart()
@@ -158,37 +308,23 @@ void pwm_restart()
 
 void pwm_start()
 {
-    pwmInfo._onLoad = pwmInfo.dutyCycle * pwmInfo._maxLoad / UINT16_MAX;
-    pwmInfo._offLoad = pwmInfo._maxLoad - pwmInfo._onLoad;
-    pwmInfo._step = PERIOD_ON;
+    pwmInfo._pending = NULL;
+    pwm_build_schedule(pwmInfo._active);
+    pwmInfo._phase = 0;
+    pwmInfo._idle = false;
 
-    if(!pwmInfo._onLoad)
+    if (!pwmInfo._maxLoad)
     {
-        debug("Can't set timer with low duty and frequency settings, put duty at 0");
-        pwmInfo.dutyCycle = 0;
+        debug("Can't start PWM without frequency set");
+        return;
     }
 
-    // 0% and 100% duty cycle are special cases: constant output.
-    if (pwmInfo.dutyCycle > 0 && pwmInfo.dutyCycle < UINT16_MAX)
-    {
-        // Trigger ON
-        uint8_t i = 0;
-        for (; i < pwmInfo.usedPins; ++i)
-        {
-            gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? false : true);
-        }
-        timer_set_load(FRC1, pwmInfo._onLoad);
-        timer_set_reload(FRC1, false);
-        timer_set_interrupts(FRC1, true);
-        timer_set_run(FRC1, true);
-    }
-    else
-    {
-        for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
-        {
-            gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? !pwmInfo.output : pwmInfo.output );
-        }       
-    }
+    /* First interrupt starts the period */
+    timer_set_load(FRC1, PWM_MIN_LOAD);
+    timer_set_reload(FRC1, false);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+
     debug("PWM started");
     pwmInfo.running = 1;
 }
@@ -197,10 +333,8 @@ void pwm_stop()
 {
     timer_set_interrupts(FRC1, false);
     timer_set_run(FRC1, false);
-    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
-    {
-        gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? true : false);
-    }       
+    pwm_write_pins(0, pwmInfo._pinMask);
+    pwmInfo._idle = false;
     debug("PWM stopped");
     pwmInfo.running = 0;
 }
@@ -20,7 +20,7 @@ extern "C" {
 
 /**
  * Initialize pwm
- * @param npins Number of pwm pin used
+ * @param npins Number of pwm pin used (GPIO0..GPIO15)
  * @param pins Array pointer to the pins
  * @param reverse If true, the pwm work in reverse mode
  */    
@@ -33,11 +33,30 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse);
 void pwm_set_freq(uint16_t freq);
 
 /**
- * Set Duty between 0 and UINT16_MAX
+ * Set Duty between 0 and UINT16_MAX for all channels and apply it
  * @param duty Duty value
  */  
 void pwm_set_duty(uint16_t duty);
 
+/**
+ * Stage Duty between 0 and UINT16_MAX for one channel.
+ * Staged duties are applied by pwm_update()
+ * @param channel Index of the pin in pins passed to pwm_init()
+ * @param duty Duty value
+ */
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty);
+
+/**
+ * Apply staged duties at the start of the next PWM period,
+ * without stopping the signal
+ */
+void pwm_update();
+
+/**
+ * Number of timer interrupts handled since pwm_init()
+ */
+uint32_t pwm_get_isr_count();
+
 /**
  * Restart the pwm signal
  */  
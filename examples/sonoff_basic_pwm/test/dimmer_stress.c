@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "pwm.h"
+#include "dimmer.h"
+
+// Stress test of the dimming worker: thousands of On/Brightness writes
+// at random short intervals, like a slider drag from the Home app, from
+// this thread while the worker runs in another. Checks that:
+//  - only one task is ever created, memory doesn't grow with the writes
+//  - the duty moves in fade steps, never jumps
+//  - bursts collapse: PWM updates are far fewer than writes times steps
+//  - once the writes stop, the duty settles at the last target
+
+#define WRITES 5000
+#define TICK_US 100             // simulated tick, 100x faster than the ESP
+#define FADE_STEP (UINT16_MAX / 20)
+
+struct sim_task {
+    pthread_t thread;
+    void (*task)(void *);
+    void *args;
+    uint32_t notifications;
+    bool waiting;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notified = PTHREAD_COND_INITIALIZER;
+
+// Only the dimmer creates a task, it is the one waiting for notifications
+static struct sim_task *worker = NULL;
+static int tasks_created = 0;
+static size_t task_memory = 0;
+
+static uint16_t duty = UINT16_MAX;
+static uint32_t duty_updates = 0;
+static int failures = 0;
+
+static void *sim_task_thread(void *arg) {
+    struct sim_task *task = arg;
+    task->task(task->args);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint16_t stack_depth,
+                       void *args, int priority, TaskHandle_t *handle) {
+    struct sim_task *t = calloc(1, sizeof(*t));
+    t->task = task;
+    t->args = args;
+
+    pthread_mutex_lock(&lock);
+    tasks_created++;
+    if (!worker)
+        worker = t;
+    task_memory += sizeof(*t) + stack_depth * sizeof(uint32_t);
+    pthread_mutex_unlock(&lock);
+
+    if (handle)
+        *handle = t;
+    pthread_create(&t->thread, NULL, sim_task_thread, t);
+    return pdPASS;
+}
+
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    pthread_mutex_lock(&lock);
+    worker->waiting = true;
+    pthread_cond_broadcast(&notified);
+    while (!worker->notifications)
+        pthread_cond_wait(&notified, &lock);
+    worker->waiting = false;
+
+    uint32_t value = worker->notifications;
+    worker->notifications = clear ? 0 : value - 1;
+    pthread_mutex_unlock(&lock);
+    return value;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&lock);
+    task->notifications++;
+    pthread_cond_broadcast(&notified);
+    pthread_mutex_unlock(&lock);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    usleep(ticks * TICK_US);
+}
+
+void pwm_set_duty(uint16_t value) {
+    pthread_mutex_lock(&lock);
+    int step = abs((int)value - (int)duty);
+    if (step > FADE_STEP) {
+        printf("FAIL: duty jumped from %u to %u\n", duty, value);
+        failures++;
+    }
+    duty = value;
+    duty_updates++;
+    pthread_mutex_unlock(&lock);
+}
+
+// Same duty lightSET() computes
+static uint16_t light_duty(bool on, int bri) {
+    return on ? (UINT16_MAX - UINT16_MAX*bri/100) : UINT16_MAX;
+}
+
+static void wait_idle() {
+    pthread_mutex_lock(&lock);
+    while (!worker->waiting || worker->notifications)
+        pthread_cond_wait(&notified, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+int main() {
+    srand(1);
+
+    if (dimmer_start(UINT16_MAX)) {
+        printf("FAIL: dimmer didn't start\n");
+        return 1;
+    }
+    size_t memory = task_memory;
+
+    bool on = false;
+    int bri = 100;
+    uint16_t target = UINT16_MAX;
+    for (int i = 0; i < WRITES; i++) {
+        if (rand() % 10 == 0)
+            on = !on;
+        else
+            bri = rand() % 101;
+
+        target = light_duty(on, bri);
+        dimmer_set(target);
+
+        // Mostly drag speed, sometimes a pause long enough to finish a fade
+        usleep(rand() % 20 ? rand() % (2 * TICK_US) : 30 * TICK_US);
+
+        if (i % 1000 == 999) {
+            pthread_mutex_lock(&lock);
+            printf("%5d writes: %u PWM updates, %d task, %zu bytes\n",
+                   i + 1, duty_updates, tasks_created, task_memory);
+            pthread_mutex_unlock(&lock);
+        }
+    }
+
+    wait_idle();
+
+    pthread_mutex_lock(&lock);
+    if (duty != target) {
+        printf("FAIL: settled at duty %u, last target %u\n", duty, target);
+        failures++;
+    }
+    if (tasks_created != 1 || task_memory != memory) {
+        printf("FAIL: %d tasks, %zu bytes after writes, %zu before\n", tasks_created, task_memory, memory);
+        failures++;
+    }
+    if (duty_updates >= (uint32_t)WRITES * 20) {
+        printf("FAIL: %u PWM updates for %d writes, bursts aren't coalesced\n", duty_updates, WRITES);
+        failures++;
+    }
+    printf("final duty %u, target %u\n", duty, target);
+    pthread_mutex_unlock(&lock);
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host simulation of the PWM interrupt schedule. pwm.c is compiled in
+// with stand-ins for GPIO registers and the FRC1 timer (stub/), the timer
+// is advanced in ticks and the interrupt handler called whenever the
+// loaded count runs out. Every handler call is logged with the output
+// levels it left behind, which is used to check that:
+//  - every channel goes high once at the start of a period and low once at
+//    its duty, channel edges come in duty order
+//  - the ISR runs once per distinct edge plus once at period start
+//  - new duties only take effect at a period boundary
+//  - the timer stops when no channel toggles and restarts on update
+
+#include "pwm.c"
+
+#define TIMER_CLOCK 5000000     // 80 MHz / 16
+#define FREQ 1000
+#define MAX_EVENTS 4096
+
+sim_gpio_t GPIO;
+
+static struct {
+    uint32_t now;
+    uint32_t remaining;
+    uint32_t max_load;
+    bool run;
+    bool interrupts;
+    void (*handler)(void *);
+    uint32_t level;
+} timer;
+
+typedef struct {
+    uint32_t time;
+    bool period_start;
+    uint32_t level;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int event_count;
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL: " __VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void gpio_apply() {
+    timer.level &= ~GPIO.OUT_CLEAR;
+    timer.level |= GPIO.OUT_SET;
+    GPIO.OUT_SET = GPIO.OUT_CLEAR = 0;
+}
+
+void gpio_enable(uint8_t gpio_num, gpio_direction_t direction) {}
+
+void timer_set_load(timer_frc_t frc, uint32_t load) { timer.remaining = load; }
+uint32_t timer_get_load(timer_frc_t frc) { return timer.max_load; }
+void timer_set_reload(timer_frc_t frc, bool reload) {}
+void timer_set_interrupts(timer_frc_t frc, bool enable) { timer.interrupts = enable; }
+void timer_set_run(timer_frc_t frc, bool run) { timer.run = run; }
+
+int timer_set_frequency(timer_frc_t frc, uint32_t freq) {
+    timer.max_load = TIMER_CLOCK / freq;
+    return 0;
+}
+
+void _xt_isr_attach(uint8_t inum, void (*handler)(void *), void *arg) {
+    timer.handler = handler;
+}
+
+static void sim_run(uint32_t ticks) {
+    uint32_t end = timer.now + ticks;
+
+    while (timer.run && timer.interrupts && timer.now + timer.remaining <= end) {
+        timer.now += timer.remaining;
+        timer.remaining = 0;
+
+        bool period_start = pwmInfo._phase == 0;
+        timer.handler(NULL);
+        gpio_apply();
+
+        if (event_count < MAX_EVENTS)
+            events[event_count++] = (event_t) { timer.now, period_start, timer.level };
+    }
+
+    if (timer.run)
+        timer.remaining -= end - timer.now;
+    timer.now = end;
+}
+
+static void sim_reset() {
+    event_count = 0;
+}
+
+// Checks one channel of every complete period in the log against duty
+static void check_channel(const char *name, int first_period, int last_period,
+                          uint8_t pin, uint16_t duty, uint32_t *fall_time) {
+    uint32_t mask = BIT(pin);
+    int period = -1;
+    uint32_t start = 0, fall = 0;
+    int rises = 0, falls = 0;
+    uint32_t level = 0;
+
+    for (int i = 0; i < event_count; i++) {
+        const event_t *e = &events[i];
+        if (e->period_start) {
+            if (period >= first_period && period <= last_period) {
+                uint32_t high = falls ? fall - start : (level & mask) ? e->time - start : 0;
+                uint32_t expected = (uint64_t)duty * timer.max_load / UINT16_MAX;
+                int error = (int)high - (int)expected;
+                CHECK(error >= -PWM_MIN_LOAD && error <= PWM_MIN_LOAD,
+                      "%s: pin %u period %d high for %u ticks, expected %u", name, pin, period, high, expected);
+                CHECK(rises <= 1 && falls <= 1,
+                      "%s: pin %u period %d has %d rising and %d falling edges", name, pin, period, rises, falls);
+                if (fall_time)
+                    fall_time[period] = falls ? fall - start : timer.max_load;
+            }
+
+            period++;
+            start = e->time;
+            rises = falls = 0;
+            if (!(level & mask) && (e->level & mask))
+                rises++;
+        } else if ((level & mask) && !(e->level & mask)) {
+            falls++;
+            fall = e->time;
+        } else if (!(level & mask) && (e->level & mask)) {
+            rises++;
+        }
+        level = e->level;
+    }
+}
+
+static int count_periods() {
+    int periods = 0;
+    for (int i = 0; i < event_count; i++)
+        periods += events[i].period_start;
+    return periods;
+}
+
+static const uint8_t pins[] = { 12, 13, 14, 15 };
+#define CHANNELS (sizeof(pins) / sizeof(*pins))
+
+static void set_duties(const uint16_t *duties) {
+    for (uint8_t i = 0; i < CHANNELS; i++)
+        pwm_set_channel_duty(i, duties[i]);
+    pwm_update();
+}
+
+static void test_schedule(const char *name, const uint16_t *duties, int expected_edges) {
+    set_duties(duties);
+    sim_run(2 * timer.max_load);    // let the new schedule take over
+    sim_reset();
+
+    uint32_t isr_count = pwm_get_isr_count();
+    sim_run(10 * timer.max_load);
+    int periods = count_periods();
+
+    uint32_t fall_time[MAX_PWM_PINS][16];
+    for (uint8_t i = 0; i < CHANNELS; i++)
+        check_channel(name, 0, periods - 2, pins[i], duties[i], fall_time[i]);
+
+    // Channel edges must come in duty order (constant channels have none)
+    for (int period = 0; period < periods - 1; period++)
+        for (uint8_t i = 0; i < CHANNELS; i++)
+            for (uint8_t j = 0; j < CHANNELS; j++)
+                if (duties[i] < duties[j] && duties[i] && duties[j] != UINT16_MAX)
+                    CHECK(fall_time[i][period] <= fall_time[j][period],
+                          "%s: period %d pin %u fell after pin %u", name, period, pins[i], pins[j]);
+
+    uint32_t calls = pwm_get_isr_count() - isr_count;
+    double per_period = (double)calls / 10;
+    printf("%-24s %5.1f ISR calls per period\n", name, per_period);
+    CHECK(calls >= 10 * (uint32_t)(expected_edges + 1) && calls <= 11 * (uint32_t)(expected_edges + 1),
+          "%s: %u ISR calls in 10 periods, expected %d per period", name, calls, expected_edges + 1);
+}
+
+static void test_update_at_boundary() {
+    const uint16_t before[CHANNELS] = { 16384, 16384, 16384, 16384 };
+    const uint16_t after[CHANNELS] = { 49152, 49152, 49152, 49152 };
+
+    set_duties(before);
+    sim_run(2 * timer.max_load);
+    sim_reset();
+
+    // Change duty in the middle of a period, while the outputs are low
+    sim_run(timer.max_load * 3 / 2);
+    set_duties(after);
+    sim_run(3 * timer.max_load);
+
+    // Period 0 is complete before the update, period 1 is interrupted by
+    // it and must still use the old duty, period 2 uses the new one.
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        check_channel("update", 0, 1, pins[i], before[i], NULL);
+        check_channel("update", 2, 2, pins[i], after[i], NULL);
+    }
+    printf("%-24s applied at period boundary\n", "update mid period");
+}
+
+static void test_idle() {
+    const uint16_t constant[CHANNELS] = { 0, UINT16_MAX, 0, UINT16_MAX };
+    const uint16_t half[CHANNELS] = { 32768, 32768, 32768, 32768 };
+
+    set_duties(constant);
+    sim_run(2 * timer.max_load);
+
+    uint32_t isr_count = pwm_get_isr_count();
+    uint32_t level = timer.level;
+    sim_run(100 * timer.max_load);
+    CHECK(pwm_get_isr_count() == isr_count, "idle: %u ISR calls with constant outputs",
+          pwm_get_isr_count() - isr_count);
+    CHECK(timer.level == level && level == (BIT(13) | BIT(15)), "idle: outputs 0x%x", timer.level);
+
+    set_duties(half);
+    sim_reset();
+    sim_run(10 * timer.max_load);
+    CHECK(count_periods() >= 9, "idle: timer didn't restart after update (%d periods)", count_periods());
+    for (uint8_t i = 0; i < CHANNELS; i++)
+        check_channel("restart", 0, count_periods() - 2, pins[i], half[i], NULL);
+    printf("%-24s timer stopped, restarted on update\n", "constant outputs");
+}
+
+int main() {
+    pwm_init(CHANNELS, pins, false);
+    pwm_set_freq(FREQ);
+    pwm_set_duty(0);
+    pwm_start();
+
+    test_schedule("one edge", (const uint16_t[]) { 32768, 32768, 32768, 32768 }, 1);
+    test_schedule("four edges", (const uint16_t[]) { 6554, 19661, 45875, 58982 }, 4);
+    test_schedule("four edges reversed", (const uint16_t[]) { 58982, 45875, 19661, 6554 }, 4);
+    test_schedule("merged close edges", (const uint16_t[]) { 32768, 32800, 16384, UINT16_MAX }, 2);
+    test_schedule("extremes", (const uint16_t[]) { 1, 0, UINT16_MAX - 1, UINT16_MAX }, 2);
+    test_update_at_boundary();
+    test_idle();
+
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-ins for the hardware pwm.c touches. GPIO register writes are
+// latched in sim_gpio and the FRC1 timer calls are implemented by
+// simulation.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define IRAM
+#define BIT(n) (1u << (n))
+
+typedef enum { GPIO_INPUT, GPIO_OUTPUT } gpio_direction_t;
+typedef enum { FRC1, FRC2 } timer_frc_t;
+#define INUM_TIMER_FRC1 9
+
+typedef struct {
+    uint32_t OUT_SET;
+    uint32_t OUT_CLEAR;
+} sim_gpio_t;
+
+extern sim_gpio_t GPIO;
+
+void gpio_enable(uint8_t gpio_num, gpio_direction_t direction);
+
+void timer_set_load(timer_frc_t frc, uint32_t load);
+uint32_t timer_get_load(timer_frc_t frc);
+void timer_set_reload(timer_frc_t frc, bool reload);
+void timer_set_interrupts(timer_frc_t frc, bool enable);
+void timer_set_run(timer_frc_t frc, bool run);
+int timer_set_frequency(timer_frc_t frc, uint32_t freq);
+
+void _xt_isr_attach(uint8_t inum, void (*handler)(void *), void *arg);
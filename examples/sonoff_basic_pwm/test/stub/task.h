@@ -0,0 +1,5 @@
+#pragma once
+
+// The simulation runs interrupts between API calls only
+#define taskENTER_CRITICAL() do {} while (0)
+#define taskEXIT_CRITICAL() do {} while (0)
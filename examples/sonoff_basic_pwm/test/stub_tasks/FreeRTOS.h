@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS task API used by dimmer.c, tasks are
+// threads (see dimmer_stress.c)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 10
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef struct sim_task *TaskHandle_t;
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint16_t stack_depth,
+                       void *args, int priority, TaskHandle_t *handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
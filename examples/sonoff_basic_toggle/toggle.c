@@ -1,53 +1,142 @@
+#include <stdlib.h>
 #include <string.h>
 #include <esplibs/libmain.h>
+#include <esp/gpio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
 #include "toggle.h"
 
 #define LPF_SHIFT 3  // divide by 8
 #define LPF_INTERVAL 10  // in milliseconds
 
-#define maxvalue_unsigned(x) ((1<<(8*sizeof(x)))-1)
+// Only GPIO0 - GPIO15 are visible in the GPIO.IN register
+#define TOGGLE_MAX_GPIO 16
+#define TOGGLE_MAX 8
 
-typedef struct _toggle {
-    uint8_t gpio_num;
-    toggle_callback_fn callback;
+#define TOGGLE_VALUE_MAX UINT16_MAX
+// Filters closer than this to their input are snapped and considered settled
+#define TOGGLE_SETTLE_BAND (TOGGLE_VALUE_MAX >> 4)
 
+typedef struct {
+    uint8_t gpio_num;
     uint8_t state;
     uint16_t value;
-    uint32_t last_event_time;
-
-    struct _toggle *next;
+    toggle_callback_fn callback;
 } toggle_t;
 
 
-toggle_t *toggles = NULL;
-TaskHandle_t task_handle = NULL;
+static toggle_t toggles[TOGGLE_MAX];
+static uint8_t toggle_count = 0;
+static SemaphoreHandle_t toggle_lock = NULL;
+static TaskHandle_t task_handle = NULL;
+
+
+static int toggle_find_by_gpio(const uint8_t gpio_num) {
+    for (int i = 0; i < toggle_count; i++)
+        if (toggles[i].gpio_num == gpio_num)
+            return i;
+
+    return -1;
+}
+
+void toggle_intr_callback(uint8_t gpio) {
+    // Wake the service and stay quiet until it re-arms us,
+    // so a bouncing contact costs a single interrupt.
+    gpio_set_interrupt(gpio, GPIO_INTTYPE_NONE, toggle_intr_callback);
+
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task_handle, &task_woken);
+    portEND_SWITCHING_ISR(task_woken);
+}
+
+static void toggle_arm(bool enable) {
+    gpio_inttype_t type = enable ? GPIO_INTTYPE_EDGE_ANY : GPIO_INTTYPE_NONE;
+    for (int i = 0; i < toggle_count; i++)
+        gpio_set_interrupt(toggles[i].gpio_num, type, toggle_intr_callback);
+}
+
+// True when every input still reads as its filtered state.
+static bool toggle_idle() {
+    uint32_t inputs = GPIO.IN;
+    for (int i = 0; i < toggle_count; i++)
+        if (!(inputs & BIT(toggles[i].gpio_num)) != !toggles[i].state)
+            return false;
+
+    return true;
+}
 
-static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
-    toggle_t *toggle = toggles;
-    while (toggle && toggle->gpio_num != gpio_num)
-        toggle = toggle->next;
+// Runs the low-pass filter of every toggle against one snapshot of the
+// input register. Fills in the callbacks to run for toggles that changed
+// and returns true when all filters have settled.
+static bool toggle_sample(uint8_t *changed, toggle_callback_fn *callbacks, uint8_t *changed_count) {
+    uint32_t inputs = GPIO.IN;
+    bool settled = true;
+
+    *changed_count = 0;
+    for (int i = 0; i < toggle_count; i++) {
+        toggle_t *toggle = &toggles[i];
+
+        int32_t target = (inputs & BIT(toggle->gpio_num)) ? TOGGLE_VALUE_MAX : 0;
+        int32_t delta = target - toggle->value;
+        if (abs(delta) > TOGGLE_SETTLE_BAND) {
+            toggle->value += delta >> LPF_SHIFT;
+            settled = false;
+        } else {
+            toggle->value = target;
+        }
+
+        uint8_t state = toggle->value > TOGGLE_VALUE_MAX / 2;
+        if (state != toggle->state) {
+            toggle->state = state;
+            changed[*changed_count] = toggle->gpio_num;
+            callbacks[*changed_count] = toggle->callback;
+            (*changed_count)++;
+        }
+    }
 
-    return toggle;
+    return settled;
 }
 
 void toggleService(void *_args) {
     const TickType_t xPeriod = pdMS_TO_TICKS(LPF_INTERVAL);
     TickType_t xLastWakeTime = xTaskGetTickCount();
 
+    uint8_t changed[TOGGLE_MAX];
+    toggle_callback_fn callbacks[TOGGLE_MAX];
+    uint8_t changed_count;
+
     for (;;) {
-        toggle_t *toggle = toggles;
-        uint8_t state = 0;
-        
-        while (toggle) {
-            toggle->value += ((gpio_read(toggle->gpio_num) * maxvalue_unsigned(toggle->value)) - toggle->value) >> LPF_SHIFT ;
-            state = (toggle->value > (maxvalue_unsigned(toggle->value) / 2));
-
-            if (state != toggle->state) {
-                toggle->state = state;
-                toggle->callback(toggle->gpio_num);
+        // Drop edges that the coming sample already accounts for.
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        xSemaphoreTake(toggle_lock, portMAX_DELAY);
+        bool settled = toggle_sample(changed, callbacks, &changed_count);
+        if (settled) {
+            // Arm before the last look at the inputs, so an edge
+            // landing in between still wakes us up.
+            toggle_arm(true);
+            if (!toggle_idle()) {
+                toggle_arm(false);
+                settled = false;
             }
-            
-            toggle = toggle->next;
+        }
+        xSemaphoreGive(toggle_lock);
+
+        // Callbacks run without the lock so they may create or delete toggles.
+        for (int i = 0; i < changed_count; i++)
+            callbacks[i](changed[i]);
+
+        if (settled) {
+            // Nothing is moving, sleep until an edge arrives.
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            xSemaphoreTake(toggle_lock, portMAX_DELAY);
+            toggle_arm(false);
+            xSemaphoreGive(toggle_lock);
+
+            xLastWakeTime = xTaskGetTickCount();
+            continue;
         }
 
         vTaskDelayUntil(&xLastWakeTime, xPeriod);
@@ -55,50 +144,60 @@ void toggleService(void *_args) {
 }
 
 int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
+    if (gpio_num >= TOGGLE_MAX_GPIO)
+        return -1;
+
+    if (toggle_lock == NULL) {
+        toggle_lock = xSemaphoreCreateMutex();
+        if (toggle_lock == NULL)
+            return -1;
+    }
+
     if (task_handle == NULL) {
         BaseType_t created = xTaskCreate(toggleService, "toggleService", 255, NULL, 2, &task_handle);
         if (created != pdPASS) {
-            task_handle = NULL;   
+            task_handle = NULL;
             return -1;
         }
     }
-    
-    toggle_t *toggle = toggle_find_by_gpio(gpio_num);
-    if (toggle)
+
+    xSemaphoreTake(toggle_lock, portMAX_DELAY);
+
+    if (toggle_count >= TOGGLE_MAX || toggle_find_by_gpio(gpio_num) >= 0) {
+        xSemaphoreGive(toggle_lock);
         return -1;
+    }
 
-    toggle = malloc(sizeof(toggle_t));
+    gpio_set_pullup(gpio_num, true, true);
+
+    toggle_t *toggle = &toggles[toggle_count++];
     memset(toggle, 0, sizeof(*toggle));
     toggle->gpio_num = gpio_num;
     toggle->callback = callback;
 
     // initial state is as initilised
     toggle->state = gpio_read(gpio_num);
+    toggle->value = toggle->state ? TOGGLE_VALUE_MAX : 0;
 
-    uint32_t now = xTaskGetTickCountFromISR();
-    toggle->last_event_time = now;
+    xSemaphoreGive(toggle_lock);
 
-    toggle->next = toggles;
-    toggles = toggle;
+    // Let the service pick up the new pin.
+    xTaskNotifyGive(task_handle);
 
-    gpio_set_pullup(toggle->gpio_num, true, true);
-    
     return 0;
 }
 
 void toggle_delete(const uint8_t gpio_num) {
-    if (!toggles)
+    if (toggle_lock == NULL)
         return;
 
-    if (toggles->gpio_num == gpio_num) {
-        toggles = toggles->next;
-    } else {
-        toggle_t *b = toggles;
-        while (b->next) {
-            if (b->next->gpio_num == gpio_num) {
-                b->next = b->next->next;
-                break;
-            }
-        }
+    xSemaphoreTake(toggle_lock, portMAX_DELAY);
+
+    int i = toggle_find_by_gpio(gpio_num);
+    if (i >= 0) {
+        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_NONE, NULL);
+        toggles[i] = toggles[--toggle_count];
     }
+
+    xSemaphoreGive(toggle_lock);
 }
@@ -32,17 +32,19 @@
 
 #include "toggle.h"
 #include "wifi.h"
+#include <wifi_manager.h>
 
 
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 // The GPIO pin that is connected to the relay on the Sonoff Dual R2
@@ -251,7 +253,6 @@ void user_init(void) {
 
     // wifi_config_init("dual lamp", NULL, on_wifi_ready);
     wifi_init();
-    on_wifi_ready();
 
     if (toggle_create(button_gpio, toggle_callback)) {
         printf("Failed to initialize button\n");
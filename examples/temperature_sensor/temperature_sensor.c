@@ -9,24 +9,36 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
-#include <dht/dht.h>
+#include <dht_reader.h>
+#include <sensor_reporter.h>
 
 
 #ifndef SENSOR_PIN
 #error SENSOR_PIN is not specified
 #endif
 
+// times in milliseconds
+#define SAMPLE_PERIOD 3000
+#define REPORT_PERIOD 30000
+#define HEARTBEAT 600000
+
+// Smallest changes worth a notification
+#define TEMPERATURE_DEADBAND 0.3
+#define HUMIDITY_DEADBAND 2.0
+
+
+void on_wifi_ready();
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 
@@ -38,31 +50,47 @@ homekit_characteristic_t temperature = HOMEKIT_CHARACTERISTIC_(CURRENT_TEMPERATU
 homekit_characteristic_t humidity    = HOMEKIT_CHARACTERISTIC_(CURRENT_RELATIVE_HUMIDITY, 0);
 
 
-void temperature_sensor_task(void *_args) {
-    gpio_set_pullup(SENSOR_PIN, false, false);
+dht_reader_t sensor;
 
+bool temperature_sensor_read(float *values, void *context) {
     float humidity_value, temperature_value;
-    while (1) {
-        bool success = dht_read_float_data(
-            DHT_TYPE_DHT11, SENSOR_PIN,
-            &humidity_value, &temperature_value
-        );
-        if (success) {
-            temperature.value.float_value = temperature_value;
-            humidity.value.float_value = humidity_value;
-
-            homekit_characteristic_notify(&temperature, HOMEKIT_FLOAT(temperature_value));
-            homekit_characteristic_notify(&humidity, HOMEKIT_FLOAT(humidity_value));
-        } else {
-            printf("Couldnt read data from sensor\n");
-        }
-
-        vTaskDelay(3000 / portTICK_PERIOD_MS);
+    bool success = dht_reader_read(&sensor, &humidity_value, &temperature_value);
+    if (!success) {
+        printf("Couldnt read data from sensor (%d failures, %d timeouts, %d checksum errors)\n",
+               sensor.stats.failures, sensor.stats.timeouts, sensor.stats.checksum_errors);
+        return false;
     }
+
+    values[0] = temperature_value;
+    values[1] = humidity_value;
+    return true;
 }
 
+const sensor_reporter_config_t reporter_config = {
+    .sample_period = SAMPLE_PERIOD,
+    .report_period = REPORT_PERIOD,
+    .heartbeat = HEARTBEAT,
+    .read = temperature_sensor_read,
+    .channel_count = 2,
+    .channels = {
+        { .ch = &temperature, .deadband = TEMPERATURE_DEADBAND, .alpha = 0.5 },
+        { .ch = &humidity, .deadband = HUMIDITY_DEADBAND, .alpha = 0.5 },
+    },
+};
+
+sensor_reporter_t reporter;
+
 void temperature_sensor_init() {
-    xTaskCreate(temperature_sensor_task, "Temperatore Sensor", 256, NULL, 2, NULL);
+    gpio_set_pullup(SENSOR_PIN, false, false);
+
+    if (dht_reader_init(&sensor, SENSOR_PIN, DHT_READER_DHT11)) {
+        printf("Failed to initialize temperature sensor\n");
+        return;
+    }
+
+    if (sensor_reporter_start(&reporter, &reporter_config)) {
+        printf("Failed to start temperature sensor\n");
+    }
 }
 
 
@@ -97,11 +125,14 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
     wifi_init();
     temperature_sensor_init();
-    homekit_server_init(&config);
 }
 
@@ -34,8 +34,10 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
-#include <dht/dht.h>
+#include <dht_reader.h>
+#include <thermostat_control.h>
 
 
 #define LED_PIN 2
@@ -46,17 +48,32 @@
 #define TEMPERATURE_POLL_PERIOD 10000
 #define HEATER_FAN_DELAY 30000
 #define COOLER_FAN_DELAY 0
+#define TEMPERATURE_FILTER_ALPHA 0.3
 
 
+// DHT11 reads whole degrees, keep relays still within a degree of the setpoint.
+// Set cycle_time (and kp, ki, kd) for time proportioning control instead.
+const thermostat_control_config_t control_config = {
+    .hysteresis = 1.0,
+    .min_on_time = 180000,
+    .min_off_time = 180000,
+};
+
+thermostat_control_t control;
+thermostat_filter_t temperature_filter;
+TaskHandle_t thermostat_task; // runs the control and drives the relays
+
+
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
 }
 
 
@@ -109,11 +126,10 @@ void fanOff() {
 }
 
 
-void update_state();
-
-
 void on_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
-    update_state();
+    // Control state and relays are only touched by the thermostat task
+    if (thermostat_task)
+        xTaskNotifyGive(thermostat_task);
 }
 
 
@@ -138,39 +154,42 @@ homekit_characteristic_t current_humidity = HOMEKIT_CHARACTERISTIC_(CURRENT_RELA
 
 
 void update_state() {
-    uint8_t state = target_state.value.int_value;
-    if ((state == 1 && current_temperature.value.float_value < target_temperature.value.float_value) ||
-            (state == 3 && current_temperature.value.float_value < heating_threshold.value.float_value)) {
-        if (current_state.value.int_value != 1) {
-            current_state.value = HOMEKIT_UINT8(1);
-            homekit_characteristic_notify(&current_state, current_state.value);
+    if (!temperature_filter.count) {
+        // No reading yet
+        return;
+    }
+
+    uint8_t state = thermostat_control_update(
+        &control, target_state.value.int_value,
+        current_temperature.value.float_value, target_temperature.value.float_value,
+        heating_threshold.value.float_value, cooling_threshold.value.float_value,
+        xTaskGetTickCount() * portTICK_PERIOD_MS
+    );
+    if (current_state.value.int_value == state)
+        return;
 
+    current_state.value = HOMEKIT_UINT8(state);
+    homekit_characteristic_notify(&current_state, current_state.value);
+
+    switch (state) {
+        case thermostat_output_heat:
             heaterOn();
             coolerOff();
             fanOff();
             fanOn(HEATER_FAN_DELAY);
-        }
-    } else if ((state == 2 && current_temperature.value.float_value > target_temperature.value.float_value) ||
-            (state == 3 && current_temperature.value.float_value > cooling_threshold.value.float_value)) {
-        if (current_state.value.int_value != 2) {
-            current_state.value = HOMEKIT_UINT8(2);
-            homekit_characteristic_notify(&current_state, current_state.value);
-
+            break;
+        case thermostat_output_cool:
             coolerOn();
             heaterOff();
             fanOff();
             fanOn(COOLER_FAN_DELAY);
-        }
-    } else {
-        if (current_state.value.int_value != 0) {
-            current_state.value = HOMEKIT_UINT8(0);
-            homekit_characteristic_notify(&current_state, current_state.value);
-
+            break;
+        default:
             coolerOff();
             heaterOff();
             fanOff();
-        }
     }
+    printf("Thermostat output %d (%d cycles)\n", state, control.cycles);
 }
 
 
@@ -187,31 +206,46 @@ void temperature_sensor_task(void *_args) {
     heaterOff();
     coolerOff();
 
+    thermostat_control_init(&control, &control_config);
+    thermostat_filter_init(&temperature_filter, TEMPERATURE_FILTER_ALPHA);
+
+    dht_reader_t sensor;
+    dht_reader_init(&sensor, TEMPERATURE_SENSOR_PIN, DHT_READER_DHT11);
+
+    TickType_t poll_period = TEMPERATURE_POLL_PERIOD / portTICK_PERIOD_MS;
+    TickType_t last_read = xTaskGetTickCount() - poll_period;
+
     float humidity_value, temperature_value;
     while (1) {
-        bool success = dht_read_float_data(
-            DHT_TYPE_DHT11, TEMPERATURE_SENSOR_PIN,
-            &humidity_value, &temperature_value
-        );
-        if (success) {
-            printf("Got readings: temperature %g, humidity %g\n", temperature_value, humidity_value);
-            current_temperature.value = HOMEKIT_FLOAT(temperature_value);
-            current_humidity.value = HOMEKIT_FLOAT(humidity_value);
-
-            homekit_characteristic_notify(&current_temperature, current_temperature.value);
-            homekit_characteristic_notify(&current_humidity, current_humidity.value);
-
-            update_state();
-        } else {
-            printf("Couldnt read data from sensor\n");
+        // Also woken up by HomeKit changes, the sensor is only read on schedule
+        if (xTaskGetTickCount() - last_read >= poll_period) {
+            last_read = xTaskGetTickCount();
+
+            bool success = dht_reader_read(&sensor, &humidity_value, &temperature_value);
+            if (success) {
+                printf("Got readings: temperature %g, humidity %g\n", temperature_value, humidity_value);
+                temperature_value = thermostat_filter_add(&temperature_filter, temperature_value);
+                current_temperature.value = HOMEKIT_FLOAT(temperature_value);
+                current_humidity.value = HOMEKIT_FLOAT(humidity_value);
+
+                homekit_characteristic_notify(&current_temperature, current_temperature.value);
+                homekit_characteristic_notify(&current_humidity, current_humidity.value);
+            } else {
+                printf("Couldnt read data from sensor (%d failures, %d timeouts, %d checksum errors)\n",
+                       sensor.stats.failures, sensor.stats.timeouts, sensor.stats.checksum_errors);
+            }
         }
 
-        vTaskDelay(TEMPERATURE_POLL_PERIOD / portTICK_PERIOD_MS);
+        // Minimum on/off times and PID cycles run even without a reading
+        update_state();
+
+        TickType_t elapsed = xTaskGetTickCount() - last_read;
+        ulTaskNotifyTake(pdTRUE, elapsed < poll_period ? poll_period - elapsed : 0);
     }
 }
 
 void thermostat_init() {
-    xTaskCreate(temperature_sensor_task, "Thermostat", 256, NULL, 2, NULL);
+    xTaskCreate(temperature_sensor_task, "Thermostat", 256, NULL, 2, &thermostat_task);
 }
 
 
@@ -248,11 +282,14 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
 
     wifi_init();
     thermostat_init();
-    homekit_server_init(&config);
 }
 
@@ -1,71 +1,196 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <espressif/esp_wifi.h>
 #include <espressif/esp_sta.h>
 #include <espressif/esp_system.h>
 #include <esp/uart.h>
 #include <esp8266.h>
-#include <etstimer.h>
 #include <esplibs/libmain.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <queue.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
+#include <wifi_manager.h>
 
 #include <dht/dht.h>
+#include <notify_scheduler.h>
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
+#ifndef MOTOR_OPEN_PIN
+#error MOTOR_OPEN_PIN is not specified
+#endif
+#ifndef MOTOR_CLOSE_PIN
+#error MOTOR_CLOSE_PIN is not specified
+#endif
+#ifndef TRAVEL_TIME
+#error TRAVEL_TIME is not specified
+#endif
+
 #define POSITION_OPEN 100
 #define POSITION_CLOSED 0
 #define POSITION_STATE_CLOSING 0
 #define POSITION_STATE_OPENING 1
 #define POSITION_STATE_STOPPED 2
 
-TaskHandle_t updateStateTask;
+// How often (in milliseconds) current position is reported while moving
+#ifndef POSITION_UPDATE_INTERVAL
+#define POSITION_UPDATE_INTERVAL 2000
+#endif
+
 homekit_characteristic_t current_position;
 homekit_characteristic_t target_position;
 homekit_characteristic_t position_state;
 homekit_accessory_t *accessories[];
 
+// Position is computed from the time the motor runs. Motion is only
+// touched by the motion task, which stops the motor when the target is
+// reached and reports the position while moving.
+typedef struct {
+    int8_t direction;
+    uint8_t start_position;
+    uint8_t target;
+    uint32_t start_time;
+    uint32_t duration;      // ms from start_time until target is reached
+    uint32_t last_update;
+} motion_t;
+
+motion_t motion = { 0 };
+QueueHandle_t motion_queue; // latest target position from HomeKit
+
+void on_wifi_ready();
+
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
+    wifi_manager_config_t wifi_config = {
         .ssid = WIFI_SSID,
         .password = WIFI_PASSWORD,
+        .on_ready = on_wifi_ready,
     };
 
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_manager_start(&wifi_config);
+}
+
+static uint32_t time_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+void motor_write(int8_t direction) {
+    // Never drive both relays at once
+    gpio_write(direction > 0 ? MOTOR_CLOSE_PIN : MOTOR_OPEN_PIN, false);
+    gpio_write(MOTOR_OPEN_PIN, direction > 0);
+    gpio_write(MOTOR_CLOSE_PIN, direction < 0);
+}
+
+void motor_init() {
+    gpio_enable(MOTOR_OPEN_PIN, GPIO_OUTPUT);
+    gpio_enable(MOTOR_CLOSE_PIN, GPIO_OUTPUT);
+    motor_write(0);
+}
+
+uint8_t motion_position() {
+    if (!motion.direction)
+        return motion.start_position;
+
+    uint32_t elapsed = time_ms() - motion.start_time;
+    int16_t position = motion.start_position + motion.direction * (int16_t)MIN(elapsed * 100 / TRAVEL_TIME, 100);
+
+    return MAX(POSITION_CLOSED, MIN(POSITION_OPEN, position));
+}
+
+void position_state_set(uint8_t state) {
+    if (position_state.value.int_value != state) {
+        position_state.value.int_value = state;
+        homekit_characteristic_notify(&position_state, position_state.value);
+    }
+}
+
+void motion_update(uint32_t now) {
+    motion.last_update = now;
+
+    current_position.value.int_value = motion_position();
+    notify_scheduler_submit(&current_position, current_position.value);
 }
 
-void update_state() {
-    while (true) {
-        uint8_t position = current_position.value.int_value;
-        int8_t direction = position_state.value.int_value == POSITION_STATE_OPENING ? 1 : -1;
-        int16_t newPosition = position + direction;
+void motion_stop() {
+    motor_write(0);
+
+    motion.direction = 0;
+    motion.start_position = motion.target;
+    printf("reached destination %u\n", motion.start_position);
 
-        printf("position %u, target %u\n", newPosition, target_position.value.int_value);
+    current_position.value.int_value = motion.start_position;
+    notify_scheduler_submit(&current_position, current_position.value);
+    notify_scheduler_flush();
+    position_state_set(POSITION_STATE_STOPPED);
+}
 
-        current_position.value.int_value = newPosition;
-        homekit_characteristic_notify(&current_position, current_position.value);
+void motion_start(uint8_t target) {
+    uint8_t position = motion_position();
+    int8_t direction = (target > position) ? 1 : (target < position) ? -1 : 0;
 
-        if (newPosition == target_position.value.int_value) {
-            printf("reached destination %u\n", newPosition);
-            position_state.value.int_value = POSITION_STATE_STOPPED;
-            homekit_characteristic_notify(&position_state, position_state.value);
-            vTaskSuspend(updateStateTask);
+    motion.target = target;
+
+    if (!direction) {
+        motion.start_position = position;
+        printf("Current position equal to target. Stopping.\n");
+        motion_stop();
+        return;
+    }
+
+    // Keeping on in the same direction leaves start time and position
+    // alone, so retargeting during a move doesn't lose the rounding of
+    // the whole percent position every time
+    if (direction != motion.direction) {
+        motion.start_position = position;
+        motion.start_time = time_ms();
+
+        motion.direction = direction;
+        motor_write(direction);
+        position_state_set(direction > 0 ? POSITION_STATE_OPENING : POSITION_STATE_CLOSING);
+
+        motion.last_update = motion.start_time;
+    }
+
+    motion.duration = (uint32_t)abs(target - motion.start_position) * TRAVEL_TIME / 100;
+}
+
+void motion_task(void *_args) {
+    uint8_t target;
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (motion.direction) {
+            uint32_t now = time_ms();
+            uint32_t elapsed = now - motion.start_time;
+            if (elapsed >= motion.duration) {
+                motion_stop();
+                continue;
+            }
+
+            if (now - motion.last_update >= POSITION_UPDATE_INTERVAL)
+                motion_update(now);
+
+            // Sleep until the target is reached or the next update is due
+            uint32_t next = MIN(motion.duration - elapsed,
+                                POSITION_UPDATE_INTERVAL - (now - motion.last_update));
+            wait = MAX(pdMS_TO_TICKS(next), 1);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(500));
+        if (xQueueReceive(motion_queue, &target, wait) == pdTRUE)
+            motion_start(target);
     }
 }
 
-void update_state_init() {
-    xTaskCreate(update_state, "UpdateState", 256, NULL, tskIDLE_PRIORITY, &updateStateTask);
-    vTaskSuspend(updateStateTask);
+void motion_init() {
+    motor_init();
+
+    motion_queue = xQueueCreate(1, sizeof(uint8_t));
+    if (!motion_queue || xTaskCreate(motion_task, "Motion", 512, NULL, 2, NULL) != pdPASS) {
+        printf("Failed to create motion task\n");
+    }
 }
 
 void window_covering_identify(homekit_value_t _value) {
@@ -112,19 +237,9 @@ homekit_accessory_t *accessories[] = {
 void on_update_target_position(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     printf("Update target position to: %u\n", target_position.value.int_value);
 
-    if (target_position.value.int_value == current_position.value.int_value) {
-        printf("Current position equal to target. Stopping.\n");
-        position_state.value.int_value = POSITION_STATE_STOPPED;
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskSuspend(updateStateTask);
-    } else {
-        position_state.value.int_value = target_position.value.int_value > current_position.value.int_value
-            ? POSITION_STATE_OPENING
-            : POSITION_STATE_CLOSING;
-
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskResume(updateStateTask);
-    }
+    // Only the latest target matters, so never wait for the motion task
+    uint8_t target = target_position.value.int_value;
+    xQueueOverwrite(motion_queue, &target);
 }
 
 homekit_server_config_t config = {
@@ -132,10 +247,15 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+void on_wifi_ready() {
+    homekit_server_init(&config);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
     wifi_init();
-    homekit_server_init(&config);
-    update_state_init();
+    notify_scheduler_init();
+    notify_scheduler_add(&current_position, POSITION_UPDATE_INTERVAL, 0);
+    motion_init();
     printf("init complete\n");
 }